@@ -1,117 +1,821 @@
 #include <opencv2/opencv.hpp>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 using namespace cv;
 
 const int kernel_size = 3;
 
-void thresholding(Mat &img, Mat &out, int lowThreshold, int highThreshold) {
-    for (int i = 1; i < img.rows - 1; i++) {
-        for (int j = 1; j < img.cols - 1; j++) {
-            if (img.at<uchar>(i, j) > highThreshold) {
-                out.at<uchar>(i, j) = 255;
-                // Prumuoviamo tutti i pixel nel suo intorno 3x3 a pixel forti
-                for (int u = -1; u <= 1; u++) {
-                    for (int v = -1; v <= 1; v++) {
-                        if (img.at<uchar>(i + u, j + v) > lowThreshold && img.at<uchar>(i + u, j + v) < highThreshold) {
-                            out.at<uchar>(i + u, j + v) = 255;
+// Calcolo della magnitudo del gradiente
+enum GradientMode {
+    GRAD_NORMALIZED, // float L2 normalizzata in [0, 255], soglie relative
+    GRAD_INT_L1,     // intera |dx| + |dy|, soglie assolute
+    GRAD_INT_L2      // intera dx^2 + dy^2, soglie assolute (confrontate al quadrato)
+};
+
+// Radice dell'albero union-find con path halving
+static inline int findRoot(vector<int> &parent, int p) {
+    while (parent[p] != p) {
+        parent[p] = parent[parent[p]];
+        p = parent[p];
+    }
+    return p;
+}
+
+// Radice senza modificare l'albero, sicura da più thread in sola lettura
+static inline int findRootConst(const vector<int> &parent, int p) {
+    while (parent[p] != p) {
+        p = parent[p];
+    }
+    return p;
+}
+
+// Unisce due componenti; la radice è l'indice minore e eredita il flag "forte"
+static inline void unite(vector<int> &parent, vector<uchar> &strong, int p, int q) {
+    int rp = findRoot(parent, p), rq = findRoot(parent, q);
+    if (rp == rq) return;
+    if (rq < rp) swap(rp, rq);
+    parent[rq] = rp;
+    strong[rp] |= strong[rq];
+}
+
+/*
+    Etichettatura union-find a strisce parallele delle componenti 8-connesse
+    dei pixel sopra la soglia bassa. parent[p] == -1 indica che il pixel p
+    non è candidato; la radice di ogni componente è il suo indice minore
+    (quindi l'etichettatura non dipende dall'ordine dei thread) e
+    strong[radice] vale 1 se la componente contiene un pixel sopra la soglia alta.
+*/
+template <typename T>
+void labelCandidates(Mat &img, T lowThreshold, T highThreshold, vector<int> &parent, vector<uchar> &strong) {
+    int rows = img.rows, cols = img.cols;
+    parent.assign(rows * cols, -1);
+    strong.assign(rows * cols, 0);
+    if (rows == 0 || cols == 0) {
+        return;
+    }
+
+    int nStrips = min(rows, max(1, getNumThreads() * 4));
+    int stripRows = (rows + nStrips - 1) / nStrips;
+    nStrips = (rows + stripRows - 1) / stripRows;
+
+    /* 1. Etichettatura locale: ogni striscia tocca solo i propri pixel */
+    parallel_for_(Range(0, nStrips), [&](const Range &range) {
+        for (int s = range.start; s < range.end; s++) {
+            int r0 = s * stripRows, r1 = min(rows, r0 + stripRows);
+            for (int y = r0; y < r1; y++) {
+                const T *row = img.ptr<T>(y);
+                for (int x = 0; x < cols; x++) {
+                    if (row[x] <= lowThreshold) continue;
+                    int p = y * cols + x;
+                    parent[p] = p;
+                    strong[p] = row[x] > highThreshold;
+                    // Vicini già visitati: sinistra e riga superiore (dentro la striscia)
+                    if (x > 0 && parent[p - 1] >= 0) unite(parent, strong, p, p - 1);
+                    if (y > r0) {
+                        for (int dx = -1; dx <= 1; dx++) {
+                            int xx = x + dx;
+                            if (xx >= 0 && xx < cols && parent[p - cols + dx] >= 0) {
+                                unite(parent, strong, p, p - cols + dx);
+                            }
                         }
                     }
                 }
             }
-            else if (img.at<uchar>(i, j) < lowThreshold) {
-                out.at<uchar>(i, j) = 0;
+        }
+    });
+
+    /* 2. Unione delle componenti lungo le cuciture tra le strisce */
+    for (int s = 1; s < nStrips; s++) {
+        int y = s * stripRows;
+        for (int x = 0; x < cols; x++) {
+            int p = y * cols + x;
+            if (parent[p] < 0) continue;
+            for (int dx = -1; dx <= 1; dx++) {
+                int xx = x + dx;
+                if (xx >= 0 && xx < cols && parent[p - cols + dx] >= 0) {
+                    unite(parent, strong, p, p - cols + dx);
+                }
             }
         }
     }
+
 }
 
-void noMaximaSuppression(Mat &magnitude, Mat &orientations, Mat &nms) {
-    for (int i = 1; i < magnitude.rows - 1; i++) {
-        for (int j = 1; j < magnitude.cols - 1; j++) {
-            // Ricaviamo l'angolo del pixel in posizione (i, j)
-            float angle = orientations.at<float>(i, j);
-            // Facciamo in modo che gli angoli varino tra -180 e 180
-            angle = (angle > 180) ? angle - 360 : angle;
+/*
+    Thresholding con isteresi: una componente di candidati viene tenuta per
+    intero se contiene almeno un pixel sopra la soglia alta, per quanto
+    lunga sia la catena di pixel deboli che lo collega.
+    T è il tipo dei pixel della nms e delle soglie (float se normalizzata,
+    int altrimenti).
+*/
+template <typename T>
+void hysteresis(Mat &img, Mat &out, T lowThreshold, T highThreshold) {
+    int rows = img.rows, cols = img.cols;
+    out = Mat::zeros(rows, cols, CV_8U);
 
-            // orizzontale
-            if ((angle > -22.5) && (angle <= 22.5) || (angle > -157.5) && (angle <= 157.5)) {
-                if (magnitude.at<uchar>(i, j) >= magnitude.at<uchar>(i, j - 1) && magnitude.at<uchar>(i, j) >= magnitude.at<uchar>(i, j + 1)) {
-                    nms.at<uchar>(i, j) = magnitude.at<uchar>(i, j);
+    vector<int> parent;
+    vector<uchar> strong;
+    labelCandidates<T>(img, lowThreshold, highThreshold, parent, strong);
+
+    /* 3. Un pixel è di edge se la sua componente contiene un pixel forte */
+    parallel_for_(Range(0, rows), [&](const Range &range) {
+        for (int y = range.start; y < range.end; y++) {
+            uchar *o = out.ptr<uchar>(y);
+            for (int x = 0; x < cols; x++) {
+                int p = y * cols + x;
+                if (parent[p] >= 0 && strong[findRootConst(parent, p)]) {
+                    o[x] = 255;
                 }
             }
+        }
+    });
+}
+
+// Indice di riga/colonna con bordo riflesso (come BORDER_DEFAULT di OpenCV)
+static inline int reflect101(int p, int len) {
+    if (len == 1) return 0;
+    if (p < 0) return -p;
+    if (p >= len) return 2 * len - p - 2;
+    return p;
+}
+
+// Settori di direzione del gradiente quantizzati
+enum { SECT_HORIZONTAL = 0, SECT_DIAG_DX, SECT_VERTICAL, SECT_DIAG_SX };
+
+// tan(22.5) e tan(67.5): confini dei 4 settori senza dover calcolare atan2
+const float TAN_22_5 = 0.41421356f;
+const float TAN_67_5 = 2.41421356f;
+
+// Magnitudo L2 e settore di direzione di un pixel
+static inline void gradientPixel(int dx, int dy, float &mag, uchar &sect) {
+    mag = std::sqrt((float)(dx * dx + dy * dy));
+
+    // Quantizzazione della direzione confrontando |dy| con |dx| * tan
+    float adx = (float)abs(dx), ady = (float)abs(dy);
+    if (ady <= adx * TAN_22_5) {
+        sect = SECT_HORIZONTAL;
+    }
+    else if (ady >= adx * TAN_67_5) {
+        sect = SECT_VERTICAL;
+    }
+    else {
+        // Gradiente verso (+x, +y) o (-x, -y): la direzione è la diagonale principale
+        sect = ((dx > 0) == (dy > 0)) ? SECT_DIAG_DX : SECT_DIAG_SX;
+    }
+}
+
+/*
+    Calcola per la riga y dell'immagine sfocata il gradiente di Sobel 3x3,
+    la magnitudo e il settore di direzione, aggiornando minimo e massimo
+    della magnitudo (servono per convertire le soglie normalizzate).
+*/
+static void gradientRow(const Mat &gauss, int y, float *mag, uchar *sect, float &magMin, float &magMax) {
+    const uchar *r0 = gauss.ptr<uchar>(reflect101(y - 1, gauss.rows));
+    const uchar *r1 = gauss.ptr<uchar>(y);
+    const uchar *r2 = gauss.ptr<uchar>(reflect101(y + 1, gauss.rows));
+    int cols = gauss.cols;
+
+    // Colonne di bordo con indici riflessi
+    for (int x : {0, cols - 1}) {
+        int xl = reflect101(x - 1, cols), xr = reflect101(x + 1, cols);
+        int dx = (r0[xr] - r0[xl]) + 2 * (r1[xr] - r1[xl]) + (r2[xr] - r2[xl]);
+        int dy = (r2[xl] + 2 * r2[x] + r2[xr]) - (r0[xl] + 2 * r0[x] + r0[xr]);
+        gradientPixel(dx, dy, mag[x], sect[x]);
+    }
+    // Colonne interne con i vicini diretti
+    for (int x = 1; x < cols - 1; x++) {
+        int dx = (r0[x + 1] - r0[x - 1]) + 2 * (r1[x + 1] - r1[x - 1]) + (r2[x + 1] - r2[x - 1]);
+        int dy = (r2[x - 1] + 2 * r2[x] + r2[x + 1]) - (r0[x - 1] + 2 * r0[x] + r0[x + 1]);
+        gradientPixel(dx, dy, mag[x], sect[x]);
+    }
+    for (int x = 0; x < cols; x++) {
+        magMin = min(magMin, mag[x]);
+        magMax = max(magMax, mag[x]);
+    }
+}
+
+/*
+    Non maxima suppression della riga centrale di un buffer circolare di tre
+    righe di magnitudo. I pixel che sono massimi lungo la direzione del
+    gradiente mantengono la loro magnitudo, gli altri vengono azzerati.
+*/
+static void nmsRow(const float *up, const float *mid, const float *down, const uchar *sect, float *out, int cols) {
+    out[0] = out[cols - 1] = 0.0f;
+    for (int x = 1; x < cols - 1; x++) {
+        float m = mid[x];
+        float a, b;
+        switch (sect[x]) {
+            // orizzontale
+            case SECT_HORIZONTAL: a = mid[x - 1]; b = mid[x + 1]; break;
             // diagonale dx
-            else if ((angle > -67.5) && (angle <= -22.5) || (angle > 112.5) && (angle <= 157.5)) {
-                if (magnitude.at<uchar>(i, j) >= magnitude.at<uchar>(i - 1, j - 1) && magnitude.at<uchar>(i, j) >= magnitude.at<uchar>(i + 1, j + 1)) {
-                    nms.at<uchar>(i, j) = magnitude.at<uchar>(i, j);
-                }                      
-            }
+            case SECT_DIAG_DX: a = up[x - 1]; b = down[x + 1]; break;
             // verticale
-            else if ((angle > -112.5) && (angle <= -67.5) || (angle > 67.5) && (angle <= 112.5)) {
-                if (magnitude.at<uchar>(i, j) >= magnitude.at<uchar>(i - 1, j) && magnitude.at<uchar>(i, j) >= magnitude.at<uchar>(i + 1, j)) {
-                    nms.at<uchar>(i, j) = magnitude.at<uchar>(i, j);
-                }
-            }   
+            case SECT_VERTICAL: a = up[x]; b = down[x]; break;
             // diagonale sx
-            else if ((angle > -157.5) && (angle <= -112.5) || (angle > 22.5) && (angle <= 67.5)) {
-                if (magnitude.at<uchar>(i, j) >= magnitude.at<uchar>(i + 1, j - 1) && magnitude.at<uchar>(i, j) >= magnitude.at<uchar>(i - 1, j + 1)) {
-                    nms.at<uchar>(i, j) = magnitude.at<uchar>(i, j);
-                }        
-            }
+            default: a = up[x + 1]; b = down[x - 1]; break;
         }
+        out[x] = (m >= a && m >= b) ? m : 0.0f;
     }
 }
 
-void Canny(Mat &src, Mat &output, int kernelSize, int lowThreshold, int highThreshold) {
+/*
+    Gradiente, magnitudo, direzione e non maxima suppression in un'unica
+    passata per righe. Si tiene in memoria solo un buffer circolare di tre
+    righe di magnitudo e settori, invece dei piani Dx, Dy, magnitudo e fase.
+    In uscita la nms (CV_32F) contiene la magnitudo dei massimi; magMin e
+    magMax sono gli estremi della magnitudo su tutta l'immagine, con cui
+    le soglie relative a [0, 255] si portano nelle unità della magnitudo
+    invece di normalizzare la nms.
+*/
+void gradientNms(Mat &gauss, Mat &nms, float &magMin, float &magMax) {
+    int rows = gauss.rows, cols = gauss.cols;
+    nms = Mat::zeros(rows, cols, CV_32F);
+    magMin = magMax = 0.0f;
+    if (rows < 3 || cols < 3) {
+        return;
+    }
+
+    Mat ringMag(3, cols, CV_32F), ringSect(3, cols, CV_8U);
+    magMin = INFINITY;
+
+    for (int y = 0; y < rows; y++) {
+        gradientRow(gauss, y, ringMag.ptr<float>(y % 3), ringSect.ptr<uchar>(y % 3), magMin, magMax);
+        // Appena disponibile la riga sotto, si sopprime la riga precedente
+        if (y >= 2) {
+            int c = y - 1;
+            nmsRow(ringMag.ptr<float>((c - 1) % 3), ringMag.ptr<float>(c % 3), ringMag.ptr<float>(y % 3),
+                   ringSect.ptr<uchar>(c % 3), nms.ptr<float>(c), cols);
+        }
+    }
+}
+
+// tan(22.5) e tan(67.5) in virgola fissa Q15 per il calcolo intero dei settori
+const int TAN_22_5_Q15 = 13573;
+const int TAN_67_5_Q15 = 79109;
+
+/*
+    Versione intera di gradientRow: dx e dy restano interi a 16 bit (il
+    Sobel 3x3 su 8 bit è compreso in [-1020, 1020]) e la magnitudo è
+    L1 oppure L2 al quadrato, quindi non servono sqrt né normalizzazione.
+    La norma è un parametro del template, così nei cicli non c'è nessuna
+    scelta a runtime: prima si scrivono dx e dy della riga nei buffer a
+    16 bit con sole somme, poi magnitudo e settore si calcolano dai buffer,
+    con AVX2 8 pixel per volta e negli altri casi con un ciclo senza salti.
+*/
+template <bool L2>
+static void gradientRowInt(const Mat &gauss, int y, short *dx, short *dy, int *mag, int *sect) {
+    const uchar *r0 = gauss.ptr<uchar>(reflect101(y - 1, gauss.rows));
+    const uchar *r1 = gauss.ptr<uchar>(y);
+    const uchar *r2 = gauss.ptr<uchar>(reflect101(y + 1, gauss.rows));
+    int cols = gauss.cols;
+
+    /* 1. Sobel 3x3: colonne di bordo con indici riflessi, interne con i vicini diretti */
+    for (int x : {0, cols - 1}) {
+        int xl = reflect101(x - 1, cols), xr = reflect101(x + 1, cols);
+        dx[x] = (short)((r0[xr] - r0[xl]) + 2 * (r1[xr] - r1[xl]) + (r2[xr] - r2[xl]));
+        dy[x] = (short)((r2[xl] + 2 * r2[x] + r2[xr]) - (r0[xl] + 2 * r0[x] + r0[xr]));
+    }
+    int x = 1;
+#ifdef __AVX2__
+    // 16 pixel per volta: i vicini a 8 bit si estendono a 16 bit e bastano somme e sottrazioni
+    for (; x + 16 <= cols - 1; x += 16) {
+        __m256i l0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r0 + x - 1)));
+        __m256i c0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r0 + x)));
+        __m256i h0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r0 + x + 1)));
+        __m256i l1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r1 + x - 1)));
+        __m256i h1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r1 + x + 1)));
+        __m256i l2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r2 + x - 1)));
+        __m256i c2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r2 + x)));
+        __m256i h2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(r2 + x + 1)));
+        __m256i d1 = _mm256_sub_epi16(h1, l1);
+        __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(h0, l0), _mm256_sub_epi16(h2, l2)), _mm256_add_epi16(d1, d1));
+        __m256i top = _mm256_add_epi16(_mm256_add_epi16(l0, h0), _mm256_add_epi16(c0, c0));
+        __m256i bottom = _mm256_add_epi16(_mm256_add_epi16(l2, h2), _mm256_add_epi16(c2, c2));
+        _mm256_storeu_si256((__m256i *)(dx + x), gx);
+        _mm256_storeu_si256((__m256i *)(dy + x), _mm256_sub_epi16(bottom, top));
+    }
+#endif
+    for (; x < cols - 1; x++) {
+        dx[x] = (short)((r0[x + 1] - r0[x - 1]) + 2 * (r1[x + 1] - r1[x - 1]) + (r2[x + 1] - r2[x - 1]));
+        dy[x] = (short)((r2[x - 1] + 2 * r2[x] + r2[x + 1]) - (r0[x - 1] + 2 * r0[x] + r0[x + 1]));
+    }
+
+    /* 2. Magnitudo e settore: diagonale secondo i segni, poi verticale se
+       |dy| >= |dx| * tan(67.5), poi orizzontale se |dy| <= |dx| * tan(22.5) */
+    x = 0;
+#ifdef __AVX2__
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i sH = _mm256_set1_epi32(SECT_HORIZONTAL), sDdx = _mm256_set1_epi32(SECT_DIAG_DX);
+    const __m256i sV = _mm256_set1_epi32(SECT_VERTICAL), sDsx = _mm256_set1_epi32(SECT_DIAG_SX);
+    const __m256i t22 = _mm256_set1_epi32(TAN_22_5_Q15), t67 = _mm256_set1_epi32(TAN_67_5_Q15);
+    for (; x + 8 <= cols; x += 8) {
+        __m256i gx = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(dx + x)));
+        __m256i gy = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(dy + x)));
+        __m256i adx = _mm256_abs_epi32(gx), ady = _mm256_abs_epi32(gy);
+        __m256i m = L2 ? _mm256_add_epi32(_mm256_mullo_epi32(gx, gx), _mm256_mullo_epi32(gy, gy)) : _mm256_add_epi32(adx, ady);
+
+        __m256i q = _mm256_slli_epi32(ady, 15);
+        __m256i same = _mm256_cmpeq_epi32(_mm256_cmpgt_epi32(gx, zero), _mm256_cmpgt_epi32(gy, zero));
+        __m256i s = _mm256_blendv_epi8(sDsx, sDdx, same);
+        // Le maschere sono le condizioni negate: dove valgono si tiene il settore precedente
+        s = _mm256_blendv_epi8(sV, s, _mm256_cmpgt_epi32(_mm256_mullo_epi32(adx, t67), q));
+        s = _mm256_blendv_epi8(sH, s, _mm256_cmpgt_epi32(q, _mm256_mullo_epi32(adx, t22)));
+        _mm256_storeu_si256((__m256i *)(mag + x), m);
+        _mm256_storeu_si256((__m256i *)(sect + x), s);
+    }
+#endif
+    for (; x < cols; x++) {
+        int gx = dx[x], gy = dy[x];
+        int adx = abs(gx), ady = abs(gy);
+        mag[x] = L2 ? gx * gx + gy * gy : adx + ady;
+        int s = ((gx > 0) == (gy > 0)) ? SECT_DIAG_DX : SECT_DIAG_SX;
+        s = ((ady << 15) >= adx * TAN_67_5_Q15) ? SECT_VERTICAL : s;
+        s = ((ady << 15) <= adx * TAN_22_5_Q15) ? SECT_HORIZONTAL : s;
+        sect[x] = s;
+    }
+}
+
+/*
+    Non maxima suppression intera della riga centrale. Per ogni pixel si
+    valutano i confronti di tutti e quattro i settori e si sceglie con una
+    maschera quello giusto, così con AVX2 si elaborano 8 pixel per volta.
+*/
+static void nmsRowInt(const int *up, const int *mid, const int *down, const int *sect, int *out, int cols) {
+    out[0] = out[cols - 1] = 0;
+    int x = 1;
+#ifdef __AVX2__
+    const __m256i sH = _mm256_set1_epi32(SECT_HORIZONTAL), sDdx = _mm256_set1_epi32(SECT_DIAG_DX);
+    const __m256i sV = _mm256_set1_epi32(SECT_VERTICAL), sDsx = _mm256_set1_epi32(SECT_DIAG_SX);
+    for (; x + 8 <= cols - 1; x += 8) {
+        __m256i m = _mm256_loadu_si256((const __m256i *)(mid + x));
+        __m256i s = _mm256_loadu_si256((const __m256i *)(sect + x));
+        __m256i ul = _mm256_loadu_si256((const __m256i *)(up + x - 1));
+        __m256i u = _mm256_loadu_si256((const __m256i *)(up + x));
+        __m256i ur = _mm256_loadu_si256((const __m256i *)(up + x + 1));
+        __m256i l = _mm256_loadu_si256((const __m256i *)(mid + x - 1));
+        __m256i r = _mm256_loadu_si256((const __m256i *)(mid + x + 1));
+        __m256i dl = _mm256_loadu_si256((const __m256i *)(down + x - 1));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(down + x));
+        __m256i dr = _mm256_loadu_si256((const __m256i *)(down + x + 1));
+
+        // Un pixel viene soppresso se uno dei due vicini nella sua direzione è maggiore
+        __m256i badH = _mm256_or_si256(_mm256_cmpgt_epi32(l, m), _mm256_cmpgt_epi32(r, m));
+        __m256i badDdx = _mm256_or_si256(_mm256_cmpgt_epi32(ul, m), _mm256_cmpgt_epi32(dr, m));
+        __m256i badV = _mm256_or_si256(_mm256_cmpgt_epi32(u, m), _mm256_cmpgt_epi32(d, m));
+        __m256i badDsx = _mm256_or_si256(_mm256_cmpgt_epi32(ur, m), _mm256_cmpgt_epi32(dl, m));
+
+        __m256i keep = _mm256_andnot_si256(badH, _mm256_cmpeq_epi32(s, sH));
+        keep = _mm256_or_si256(keep, _mm256_andnot_si256(badDdx, _mm256_cmpeq_epi32(s, sDdx)));
+        keep = _mm256_or_si256(keep, _mm256_andnot_si256(badV, _mm256_cmpeq_epi32(s, sV)));
+        keep = _mm256_or_si256(keep, _mm256_andnot_si256(badDsx, _mm256_cmpeq_epi32(s, sDsx)));
+        _mm256_storeu_si256((__m256i *)(out + x), _mm256_and_si256(m, keep));
+    }
+#endif
+    for (; x < cols - 1; x++) {
+        int m = mid[x];
+        bool keepH = m >= mid[x - 1] && m >= mid[x + 1];
+        bool keepDdx = m >= up[x - 1] && m >= down[x + 1];
+        bool keepV = m >= up[x] && m >= down[x];
+        bool keepDsx = m >= up[x + 1] && m >= down[x - 1];
+        bool keep = (sect[x] == SECT_HORIZONTAL && keepH) || (sect[x] == SECT_DIAG_DX && keepDdx) ||
+                    (sect[x] == SECT_VERTICAL && keepV) || (sect[x] == SECT_DIAG_SX && keepDsx);
+        out[x] = keep ? m : 0;
+    }
+}
+
+/*
+    Gradiente intero e nms delle righe [y0, y1) con un proprio buffer
+    circolare: si calcola il gradiente anche della riga prima e di quella
+    dopo, così strisce diverse non condividono nulla.
+*/
+template <bool L2>
+static void gradientNmsIntRows(const Mat &gauss, Mat &nms, int y0, int y1) {
+    int cols = gauss.cols;
+    Mat ringMag(3, cols, CV_32S), ringSect(3, cols, CV_32S);
+    vector<short> dx(cols), dy(cols);
+
+    // 1 <= y0 e y1 <= rows - 1: le righe in più sono sempre dentro l'immagine
+    for (int y = y0 - 1; y <= y1; y++) {
+        gradientRowInt<L2>(gauss, y, dx.data(), dy.data(), ringMag.ptr<int>(y % 3), ringSect.ptr<int>(y % 3));
+        // Appena disponibile la riga sotto, si sopprime la riga precedente
+        int c = y - 1;
+        if (c >= y0) {
+            nmsRowInt(ringMag.ptr<int>((c - 1) % 3), ringMag.ptr<int>(c % 3), ringMag.ptr<int>(y % 3),
+                      ringSect.ptr<int>(c % 3), nms.ptr<int>(c), cols);
+        }
+    }
+}
+
+/*
+    Come gradientNms ma interamente su interi e senza normalizzazione:
+    la nms in uscita (CV_32S) contiene la magnitudo assoluta dei massimi,
+    quindi le soglie dell'isteresi hanno lo stesso significato su ogni immagine.
+    Le righe sono divise in strisce parallele che si sovrappongono di due
+    righe di gradiente (una sopra e una sotto); la prima e l'ultima riga
+    dell'immagine non hanno nms e restano a zero.
+*/
+void gradientNmsInt(Mat &gauss, Mat &nms, bool l2) {
+    int rows = gauss.rows, cols = gauss.cols;
+    nms = Mat::zeros(rows, cols, CV_32S);
+    if (rows < 3 || cols < 3) {
+        return;
+    }
+
+    int nStrips = min(rows - 2, max(1, getNumThreads() * 2));
+    parallel_for_(Range(0, nStrips), [&](const Range &range) {
+        for (int s = range.start; s < range.end; s++) {
+            int y0 = 1 + (rows - 2) * s / nStrips, y1 = 1 + (rows - 2) * (s + 1) / nStrips;
+            if (l2) {
+                gradientNmsIntRows<true>(gauss, nms, y0, y1);
+            }
+            else {
+                gradientNmsIntRows<false>(gauss, nms, y0, y1);
+            }
+        }
+    });
+}
+
+void Canny(Mat &src, Mat &output, int kernelSize, int lowThreshold, int highThreshold, GradientMode mode = GRAD_NORMALIZED) {
     Mat gauss;
     /* 1. Convolvere l'immagine con il filtro Gaussiano */
     GaussianBlur(src, gauss, Size(5, 5), 0, 0);
 
-    /* 2. Calcolare magnitudo e angolo di fase del vettore gradiente */
-    // Calcolo del vettore gradiente
-    Mat Dx, Dy;
-    Sobel(gauss, Dx, CV_32FC1, 1, 0, kernel_size);
-    Sobel(gauss, Dy, CV_32FC1, 0, 1, kernel_size);
-    // Calcolo della magnitudo con formula standard
-    Mat Dx2, Dy2, magnitude;
-    pow(Dx, 2, Dx2);
-    pow(Dy, 2, Dy2);
-    sqrt(Dx2 + Dy2, magnitude);
-    // Normalizzazione della magnitudo
-    normalize(magnitude, magnitude, 0, 255, NORM_MINMAX, CV_8U);
-    //imshow("magnitudo", magnitude);
-    // Calcolo dell'angolo di fase con la funzione phase
-    Mat orientations;
-    phase(Dx, Dy, orientations, true);
-    //imshow("angolo di fase", orientations);
-    //waitKey(0);
-    /* 3. Applicare la non maxima suppression */
-    Mat nms = Mat::zeros(magnitude.rows, magnitude.cols, CV_8U);
-    noMaximaSuppression(magnitude, orientations, nms);
-    //imshow("no maxima suppression", nms);
-
-    /* 4. Applicare il tresholding con isteresi */
-    Mat out = Mat::zeros(nms.rows, nms.cols, CV_8U);
-    thresholding(nms, out, lowThreshold, highThreshold);
+    /* 2. Calcolare magnitudo e direzione del gradiente e
+       3. applicare la non maxima suppression, in un'unica passata */
+    Mat nms, out;
+    if (mode == GRAD_NORMALIZED) {
+        float magMin, magMax;
+        gradientNms(gauss, nms, magMin, magMax);
+        //imshow("no maxima suppression", nms);
+
+        /* 4. Applicare il tresholding con isteresi. Le soglie sono relative
+           alla magnitudo normalizzata in [0, 255] come con NORM_MINMAX: un
+           massimo normalizzato e arrotondato supera T se la sua magnitudo
+           supera magMin + (T + 0.5) / scale. Con magnitudo costante non c'è
+           nessun edge */
+        if (magMax > magMin) {
+            float scale = 255.0f / (magMax - magMin);
+            hysteresis<float>(nms, out, magMin + (lowThreshold + 0.5f) / scale, magMin + (highThreshold + 0.5f) / scale);
+        }
+        else {
+            out = Mat::zeros(src.rows, src.cols, CV_8U);
+        }
+    }
+    else {
+        // Con L2 al quadrato anche le soglie vanno elevate al quadrato
+        bool l2 = mode == GRAD_INT_L2;
+        gradientNmsInt(gauss, nms, l2);
+        if (l2) {
+            lowThreshold *= lowThreshold;
+            highThreshold *= highThreshold;
+        }
+        hysteresis<int>(nms, out, lowThreshold, highThreshold);
+    }
     //imshow("threshold", out);
     //waitKey(0);
     output = out;
 }
 
+/*
+    CANNY A TILE (OUT-OF-CORE)
+    Per immagini troppo grandi per stare in memoria l'input è un PGM binario
+    (P5, 8 bit) letto tile per tile con seek per riga, e l'uscita è scritta
+    tile per tile in un altro PGM. Ogni tile viene letto con un alone di
+    TILE_HALO pixel: 2 per la Gaussiana 5x5, 1 per il Sobel 3x3 e 1 per la nms.
+    Si usano le magnitudo intere con soglie assolute, perché la
+    normalizzazione min/max richiederebbe di conoscere tutta l'immagine.
+
+    L'isteresi tra tile diversi si risolve così:
+    - passata 1: per ogni tile si calcola la nms, si classificano i pixel
+      (0 nessuno, 1 debole, 2 forte) in un file temporaneo e si etichettano
+      le componenti locali; solo le componenti che toccano il bordo del tile
+      diventano nodi di un union-find globale, unite con quelle dei tile
+      adiacenti lungo le cuciture;
+    - passata 2: per ogni tile si rilegge la classificazione, si rietichetta
+      (l'etichettatura è deterministica) e un pixel è di edge se la sua
+      componente è forte localmente o tramite il nodo globale.
+    In memoria restano i buffer di un tile, l'ultima riga di tile e i soli
+    nodi delle componenti di bordo, non piani grandi quanto l'immagine.
+*/
+const int TILE_HALO = 4;
+
+struct PgmInfo {
+    int width, height;
+    streamoff dataOffset;
+};
+
+// Salta spazi e commenti dell'intestazione PGM
+static void skipPgmSpaces(istream &in) {
+    int c;
+    while ((c = in.peek()) != EOF) {
+        if (c == '#') {
+            string comment;
+            getline(in, comment);
+        }
+        else if (isspace(c)) {
+            in.get();
+        }
+        else {
+            break;
+        }
+    }
+}
+
+static bool readPgmHeader(istream &in, PgmInfo &info) {
+    string magic;
+    int maxVal;
+    in >> magic;
+    if (magic != "P5") return false;
+    skipPgmSpaces(in);
+    in >> info.width;
+    skipPgmSpaces(in);
+    in >> info.height;
+    skipPgmSpaces(in);
+    in >> maxVal;
+    // Dopo maxval c'è un solo carattere di spaziatura prima dei dati
+    in.get();
+    info.dataOffset = in.tellg();
+    return in.good() && maxVal == 255 && info.width > 0 && info.height > 0;
+}
+
+/*
+    Legge la regione r di un'immagine 8 bit memorizzata per righe a partire
+    da offset; false se il file è più corto o la lettura non riesce.
+*/
+static bool readRegion(istream &in, streamoff offset, int width, Rect r, Mat &dst) {
+    dst.create(r.height, r.width, CV_8U);
+    for (int y = 0; y < r.height; y++) {
+        in.seekg(offset + (streamoff)(r.y + y) * width + r.x);
+        in.read((char *)dst.ptr<uchar>(y), r.width);
+        if (in.gcount() != r.width) return false;
+    }
+    return true;
+}
+
+static void writeRegion(ostream &out, streamoff offset, int width, Rect r, const Mat &src) {
+    for (int y = 0; y < r.height; y++) {
+        out.seekp(offset + (streamoff)(r.y + y) * width + r.x);
+        out.write((const char *)src.ptr<uchar>(y), r.width);
+    }
+}
+
+// Crea un file di dimensione fissa che verrà riempito tile per tile
+static bool createFile(fstream &f, const string &path, const string &header, streamoff dataSize) {
+    f.open(path, ios::in | ios::out | ios::binary | ios::trunc);
+    if (!f.is_open()) return false;
+    f << header;
+    f.seekp((streamoff)header.size() + dataSize - 1);
+    f.put(0);
+    return f.good();
+}
+
+/*
+    Assegna un indice compatto alle componenti che toccano il bordo del tile,
+    scorrendo il perimetro sempre nello stesso ordine, così le due passate
+    ottengono gli stessi indici. Restituisce il numero di componenti di bordo.
+*/
+static int borderRoots(const vector<int> &parent, int tw, int th, unordered_map<int, int> &rootId) {
+    rootId.clear();
+    auto visit = [&](int x, int y) {
+        int p = y * tw + x;
+        if (parent[p] < 0) return;
+        int root = findRootConst(parent, p);
+        if (rootId.find(root) == rootId.end()) {
+            int id = rootId.size();
+            rootId[root] = id;
+        }
+    };
+    for (int x = 0; x < tw; x++) {
+        visit(x, 0);
+        visit(x, th - 1);
+    }
+    for (int y = 0; y < th; y++) {
+        visit(0, y);
+        visit(tw - 1, y);
+    }
+    return rootId.size();
+}
+
+bool tiledCanny(const string &inPath, const string &outPath, int tileSize, int lowThreshold, int highThreshold, GradientMode mode) {
+    ifstream in(inPath, ios::binary);
+    PgmInfo info;
+    if (!in.is_open() || !readPgmHeader(in, info)) {
+        cout << "Could not read " << inPath << " as a binary 8 bit PGM" << endl;
+        return false;
+    }
+    int W = info.width, H = info.height;
+    bool l2 = mode == GRAD_INT_L2;
+    if (l2) {
+        lowThreshold *= lowThreshold;
+        highThreshold *= highThreshold;
+    }
+
+    // File temporaneo con la classificazione dei pixel e file di uscita
+    string clsPath = outPath + ".cls.tmp";
+    string header = "P5\n" + to_string(W) + " " + to_string(H) + "\n255\n";
+    fstream cls, out;
+    if (!createFile(cls, clsPath, "", (streamoff)W * H) || !createFile(out, outPath, header, (streamoff)W * H)) {
+        cout << "Could not create " << outPath << endl;
+        cls.close();
+        remove(clsPath.c_str());
+        return false;
+    }
+    // In caso di errore non restano né il file temporaneo né un'uscita incompleta
+    auto fail = [&](const string &message) {
+        cout << message << endl;
+        cls.close();
+        out.close();
+        remove(clsPath.c_str());
+        remove(outPath.c_str());
+        return false;
+    };
+
+    int tilesX = (W + tileSize - 1) / tileSize, tilesY = (H + tileSize - 1) / tileSize;
+    vector<int> tileBase(tilesX * tilesY);
+    // Union-find globale sulle sole componenti di bordo dei tile
+    vector<int> gParent;
+    vector<uchar> gStrong;
+    // Nodi globali dell'ultima riga della riga di tile precedente e della
+    // colonna destra del tile precedente (-1 se il pixel non è candidato)
+    vector<int> prevBottom(W, -1), curBottom(W, -1), prevRight;
+
+    Mat region, gauss, nms, c;
+    vector<int> parent;
+    vector<uchar> strong;
+    unordered_map<int, int> rootId;
+
+    /* Passata 1: nms, classificazione e cuciture tra tile */
+    for (int ty = 0; ty < tilesY; ty++) {
+        fill(curBottom.begin(), curBottom.end(), -1);
+        for (int tx = 0; tx < tilesX; tx++) {
+            Rect core(tx * tileSize, ty * tileSize, min(tileSize, W - tx * tileSize), min(tileSize, H - ty * tileSize));
+            Rect haloRect(core.x - TILE_HALO, core.y - TILE_HALO, core.width + 2 * TILE_HALO, core.height + 2 * TILE_HALO);
+            haloRect = haloRect & Rect(0, 0, W, H);
+
+            // Ai bordi dell'immagine la regione coincide con il bordo e la
+            // riflessione di GaussianBlur e del Sobel è la stessa dell'immagine intera
+            if (!readRegion(in, info.dataOffset, W, haloRect, region)) {
+                return fail("Could not read " + inPath + ": truncated image data");
+            }
+            GaussianBlur(region, gauss, Size(5, 5), 0, 0);
+            gradientNmsInt(gauss, nms, l2);
+
+            int tw = core.width, th = core.height;
+            int ox = core.x - haloRect.x, oy = core.y - haloRect.y;
+            c.create(th, tw, CV_8U);
+            for (int y = 0; y < th; y++) {
+                const int *n = nms.ptr<int>(y + oy) + ox;
+                uchar *o = c.ptr<uchar>(y);
+                for (int x = 0; x < tw; x++) {
+                    o[x] = n[x] > highThreshold ? 2 : (n[x] > lowThreshold ? 1 : 0);
+                }
+            }
+            writeRegion(cls, 0, W, core, c);
+
+            labelCandidates<uchar>(c, 0, 1, parent, strong);
+            int nBorder = borderRoots(parent, tw, th, rootId);
+            int base = gParent.size();
+            tileBase[ty * tilesX + tx] = base;
+            for (int i = 0; i < nBorder; i++) {
+                gParent.push_back(base + i);
+                gStrong.push_back(0);
+            }
+            for (auto &rid : rootId) {
+                gStrong[base + rid.second] = strong[rid.first];
+            }
+            auto node = [&](int x, int y) {
+                int p = y * tw + x;
+                return parent[p] < 0 ? -1 : base + rootId[findRootConst(parent, p)];
+            };
+
+            // Cucitura con la riga di tile superiore (anche in diagonale)
+            if (ty > 0) {
+                for (int x = 0; x < tw; x++) {
+                    int n0 = node(x, 0);
+                    if (n0 < 0) continue;
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int gx = core.x + x + dx;
+                        if (gx >= 0 && gx < W && prevBottom[gx] >= 0) {
+                            unite(gParent, gStrong, n0, prevBottom[gx]);
+                        }
+                    }
+                }
+            }
+            // Cucitura con il tile a sinistra
+            if (tx > 0) {
+                for (int y = 0; y < th; y++) {
+                    int n0 = node(0, y);
+                    if (n0 < 0) continue;
+                    for (int dy = -1; dy <= 1; dy++) {
+                        int yy = y + dy;
+                        if (yy >= 0 && yy < th && prevRight[yy] >= 0) {
+                            unite(gParent, gStrong, n0, prevRight[yy]);
+                        }
+                    }
+                }
+            }
+
+            for (int x = 0; x < tw; x++) {
+                curBottom[core.x + x] = node(x, th - 1);
+            }
+            prevRight.assign(th, -1);
+            for (int y = 0; y < th; y++) {
+                prevRight[y] = node(tw - 1, y);
+            }
+        }
+        swap(prevBottom, curBottom);
+    }
+
+    /* Passata 2: isteresi definitiva e scrittura dell'uscita tile per tile */
+    Mat edges;
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            Rect core(tx * tileSize, ty * tileSize, min(tileSize, W - tx * tileSize), min(tileSize, H - ty * tileSize));
+            int tw = core.width, th = core.height;
+            if (!readRegion(cls, 0, W, core, c)) {
+                return fail("Could not read back " + clsPath);
+            }
+            labelCandidates<uchar>(c, 0, 1, parent, strong);
+            borderRoots(parent, tw, th, rootId);
+            int base = tileBase[ty * tilesX + tx];
+
+            edges = Mat::zeros(th, tw, CV_8U);
+            for (int y = 0; y < th; y++) {
+                uchar *o = edges.ptr<uchar>(y);
+                for (int x = 0; x < tw; x++) {
+                    int p = y * tw + x;
+                    if (parent[p] < 0) continue;
+                    int root = findRootConst(parent, p);
+                    bool isStrong = strong[root];
+                    if (!isStrong) {
+                        auto it = rootId.find(root);
+                        isStrong = it != rootId.end() && gStrong[findRoot(gParent, base + it->second)];
+                    }
+                    o[x] = isStrong ? 255 : 0;
+                }
+            }
+            writeRegion(out, header.size(), W, core, edges);
+        }
+    }
+
+    if (!cls.good() || !out.good()) {
+        return fail("Could not write " + outPath);
+    }
+    cls.close();
+    remove(clsPath.c_str());
+    return true;
+}
+
 int main(int argc, char **argv) {
     Mat img, output;
     String img_name;
     int lowThreshold, highThreshold;
 
     // Controllo valori passati da riga di comando
-    if (argc != 4) {
-        cout << "Usage: " << argv[0] << " img_name lowThreshold highThreshold" << endl;
+    if (argc != 4 && argc != 5 && argc != 7) {
+        cout << "Usage: " << argv[0] << " img_name lowThreshold highThreshold [L1|L2 [tileSize out.pgm]]" << endl;
+        cout << "  senza L1/L2 le soglie sono relative alla magnitudo normalizzata in [0, 255]," << endl;
+        cout << "  con L1/L2 sono soglie assolute sulla magnitudo intera del gradiente" << endl;
+        cout << "  con tileSize e out.pgm l'immagine (PGM binario) viene elaborata a tile" << endl;
         return -1;
     }
     img_name = argv[1];
+    lowThreshold = stoi(argv[2]);
+    highThreshold = stoi(argv[3]);
+
+    GradientMode mode = GRAD_NORMALIZED;
+    if (argc >= 5) {
+        String norm = argv[4];
+        if (norm == "L1") {
+            mode = GRAD_INT_L1;
+        }
+        else if (norm == "L2") {
+            mode = GRAD_INT_L2;
+        }
+        else {
+            cout << "Unknown norm " << norm << ", use L1 or L2" << endl;
+            return -1;
+        }
+    }
+
+    // Modalità a tile: l'immagine non viene mai caricata per intero
+    if (argc == 7) {
+        int tileSize = stoi(argv[5]);
+        if (tileSize < 1) {
+            cout << "tileSize must be positive" << endl;
+            return -1;
+        }
+        return tiledCanny(img_name, argv[6], tileSize, lowThreshold, highThreshold, mode) ? 0 : -1;
+    }
 
     // Lettura immagine come parametro da riga di comando
     img = imread(img_name, IMREAD_GRAYSCALE);
@@ -120,10 +824,7 @@ int main(int argc, char **argv) {
         return -1;
     }
 
-    lowThreshold = stoi(argv[2]);
-    highThreshold = stoi(argv[3]);
-
-    Canny(img, output, kernel_size, lowThreshold, highThreshold);
+    Canny(img, output, kernel_size, lowThreshold, highThreshold, mode);
 
     imshow("Canny", output);
     waitKey(0);
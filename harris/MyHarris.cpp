@@ -1,55 +1,357 @@
 #include <opencv2/opencv.hpp>
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 using namespace cv;
 
-void Harris(Mat &src, Mat &output, int kernel_size, float k, int threshold) {
+/*
+    Calcola la risposta di Harris R = det(M) - k * trace(M)^2 in un'unica
+    passata per righe. Le tre componenti del tensore di struttura
+    (Dx^2, Dy^2, Dx*Dy) sono calcolate una volta per riga e tenute
+    interlacciate in un buffer circolare di righe grande quanto il filtro;
+    per ogni riga di uscita si applica il filtro Gaussiano separabile prima
+    in verticale e poi in orizzontale sulle tre componenti insieme, con
+    cicli contigui sulla riga interlacciata, e si valuta subito R. Dopo i gradienti si legge e si scrive ogni pixel una
+    sola volta, senza i piani intermedi dx2, dy2, dxdy, det e trace.
+*/
+void harrisResponseRows(const Mat &dx, const Mat &dy, Mat &R, float k, const Mat &kernel, int y0, int y1) {
+    int rows = dx.rows, cols = dx.cols;
+    int blurSize = kernel.rows, half = blurSize / 2;
+    const float *g = kernel.ptr<float>(0);
+
+    Mat ring(blurSize, cols * 3, CV_32F);
+    vector<int> slotRow(blurSize, -1);
+    /* Riga filtrata in verticale con bordo riflesso di half pixel per lato;
+       borderInterpolate riflette più volte se l'immagine è più piccola del filtro */
+    vector<float> vbuf((cols + 2 * half) * 3);
+    // Riga filtrata anche in orizzontale, sempre interlacciata
+    vector<float> hbuf(cols * 3);
+
+    for (int y = y0; y < y1; y++) {
+        /* 1. Prodotti del gradiente delle righe nella finestra, solo se non già presenti */
+        for (int i = -half; i <= half; i++) {
+            int r = borderInterpolate(y + i, rows, BORDER_REFLECT_101);
+            int slot = r % blurSize;
+            if (slotRow[slot] == r) continue;
+            const float *px = dx.ptr<float>(r), *py = dy.ptr<float>(r);
+            float *t = ring.ptr<float>(slot);
+            for (int x = 0; x < cols; x++) {
+                t[3 * x] = px[x] * px[x];
+                t[3 * x + 1] = py[x] * py[x];
+                t[3 * x + 2] = px[x] * py[x];
+            }
+            slotRow[slot] = r;
+        }
+
+        /* 2. Filtro Gaussiano verticale sulle componenti interlacciate */
+        float *v = vbuf.data() + 3 * half;
+        for (int c = 0; c < cols * 3; c++) {
+            v[c] = 0.0f;
+        }
+        for (int i = -half; i <= half; i++) {
+            const float *t = ring.ptr<float>(borderInterpolate(y + i, rows, BORDER_REFLECT_101) % blurSize);
+            float w = g[i + half];
+            for (int c = 0; c < cols * 3; c++) {
+                v[c] += w * t[c];
+            }
+        }
+        for (int i = 1; i <= half; i++) {
+            for (int c = 0; c < 3; c++) {
+                v[-3 * i + c] = v[3 * borderInterpolate(-i, cols, BORDER_REFLECT_101) + c];
+                v[3 * (cols - 1 + i) + c] = v[3 * borderInterpolate(cols - 1 + i, cols, BORDER_REFLECT_101) + c];
+            }
+        }
+
+        /* 3. Filtro Gaussiano orizzontale: le tre componenti di un pixel
+           distano 3 elementi da quelle del vicino, quindi ogni tap è una
+           somma contigua su tutta la riga interlacciata, come in verticale */
+        float *h = hbuf.data();
+        for (int c = 0; c < cols * 3; c++) {
+            h[c] = 0.0f;
+        }
+        for (int i = -half; i <= half; i++) {
+            const float *t = v + 3 * i;
+            float w = g[i + half];
+            for (int c = 0; c < cols * 3; c++) {
+                h[c] += w * t[c];
+            }
+        }
+
+        /* 4. Calcolo di R */
+        float *out = R.ptr<float>(y);
+        for (int x = 0; x < cols; x++) {
+            float sxx = h[3 * x], syy = h[3 * x + 1], sxy = h[3 * x + 2];
+            float trace = sxx + syy;
+            out[x] = sxx * syy - sxy * sxy - k * trace * trace;
+        }
+    }
+}
+
+// Risposta di Harris dell'immagine intera, a strisce di righe parallele
+void harrisResponse(const Mat &dx, const Mat &dy, Mat &R, float k, int blurSize, double sigma) {
+    int rows = dx.rows;
+    Mat kernel = getGaussianKernel(blurSize, sigma, CV_32F);
+    R.create(rows, dx.cols, CV_32F);
+
+    // Ogni striscia di righe ha il suo buffer circolare, così le strisce sono indipendenti
+    int nStrips = min(rows, max(1, getNumThreads() * 2));
+    parallel_for_(Range(0, nStrips), [&](const Range &range) {
+        for (int s = range.start; s < range.end; s++) {
+            harrisResponseRows(dx, dy, R, k, kernel, rows * s / nStrips, rows * (s + 1) / nStrips);
+        }
+    });
+}
+
+// Corner individuato: posizione e valore della risposta R
+struct Corner {
+    int x, y;
+    float response;
+};
+
+/*
+    Estrae i corner da R: un pixel è corner se supera minResponse ed è il
+    massimo nella finestra (2 * nmsRadius + 1)^2 (a parità di valore vince
+    il primo in ordine di scansione). Se maxCorners > 0 l'immagine è divisa
+    in una griglia gridSize x gridSize e ogni cella tiene solo i suoi
+    corner migliori con un heap limitato, così i corner restano distribuiti
+    e non si concentrano tutti sulla zona più texturizzata; alla fine si
+    tengono i maxCorners migliori in assoluto.
+*/
+void extractCorners(const Mat &R, vector<Corner> &corners, float minResponse, int nmsRadius, int maxCorners, int gridSize) {
+    int rows = R.rows, cols = R.cols;
+    corners.clear();
+
+    /* 1. Non maxima suppression a strisce parallele */
+    int nStrips = min(rows, max(1, getNumThreads() * 2));
+    vector<vector<Corner>> stripCorners(nStrips);
+    parallel_for_(Range(0, nStrips), [&](const Range &range) {
+        for (int s = range.start; s < range.end; s++) {
+            int y0 = rows * s / nStrips, y1 = rows * (s + 1) / nStrips;
+            for (int y = y0; y < y1; y++) {
+                const float *row = R.ptr<float>(y);
+                for (int x = 0; x < cols; x++) {
+                    float v = row[x];
+                    if (v <= minResponse) continue;
+                    bool isMax = true;
+                    for (int u = max(0, y - nmsRadius); u <= min(rows - 1, y + nmsRadius) && isMax; u++) {
+                        const float *nr = R.ptr<float>(u);
+                        for (int w = max(0, x - nmsRadius); w <= min(cols - 1, x + nmsRadius); w++) {
+                            bool before = u < y || (u == y && w < x);
+                            if (nr[w] > v || (before && nr[w] == v)) {
+                                isMax = false;
+                                break;
+                            }
+                        }
+                    }
+                    if (isMax) {
+                        stripCorners[s].push_back({x, y, v});
+                    }
+                }
+            }
+        }
+    });
+
+    auto stronger = [](const Corner &a, const Corner &b) { return a.response > b.response; };
+    if (maxCorners <= 0) {
+        for (auto &sc : stripCorners) {
+            corners.insert(corners.end(), sc.begin(), sc.end());
+        }
+        return;
+    }
+
+    /* 2. Selezione dei migliori per cella della griglia con heap limitati:
+          con stronger come confronto in cima all'heap c'è il corner più debole */
+    gridSize = max(1, gridSize);
+    int perCell = (maxCorners + gridSize * gridSize - 1) / (gridSize * gridSize);
+    vector<vector<Corner>> cells(gridSize * gridSize);
+    for (auto &sc : stripCorners) {
+        for (const Corner &c : sc) {
+            int cell = (c.y * gridSize / rows) * gridSize + c.x * gridSize / cols;
+            vector<Corner> &heap = cells[cell];
+            if ((int)heap.size() < perCell) {
+                heap.push_back(c);
+                push_heap(heap.begin(), heap.end(), stronger);
+            }
+            else if (c.response > heap.front().response) {
+                pop_heap(heap.begin(), heap.end(), stronger);
+                heap.back() = c;
+                push_heap(heap.begin(), heap.end(), stronger);
+            }
+        }
+    }
+    for (auto &heap : cells) {
+        corners.insert(corners.end(), heap.begin(), heap.end());
+    }
+
+    /* 3. I maxCorners migliori in assoluto, in ordine di risposta decrescente */
+    if ((int)corners.size() > maxCorners) {
+        nth_element(corners.begin(), corners.begin() + maxCorners, corners.end(), stronger);
+        corners.resize(maxCorners);
+    }
+    sort(corners.begin(), corners.end(), stronger);
+}
+
+// Disegno dei corner, separato dal rilevamento
+void drawCorners(Mat &img, const vector<Corner> &corners) {
+    for (const Corner &c : corners) {
+        circle(img, Point(c.x, c.y), 6, Scalar(0), 2, 8, 0);
+    }
+}
+
+/*
+    Rilevatore di Harris. threshold è espressa rispetto a R normalizzato in
+    [0, 255], come prima, ma viene convertita in una soglia su R invece di
+    normalizzare tutta l'immagine.
+*/
+void HarrisCorners(Mat &src, vector<Corner> &corners, int kernel_size, float k, int threshold, int maxCorners = 0, int gridSize = 1) {
     // 1. Calcola le componenti del vettore gradiente
     Mat dx, dy;
     Sobel(src, dx, CV_32FC1, 1, 0, kernel_size, BORDER_DEFAULT);
     Sobel(src, dy, CV_32FC1, 0, 1, kernel_size, BORDER_DEFAULT);
 
-    // 2. Calcolare le componenti della matrice E
-    // Dx^2, Dy^2 e Dx*Dy
-    Mat dx2, dy2, dxdy;
-    pow(dx, 2.0, dx2);
-    pow(dy, 2.0, dy2);
-    multiply(dx, dy, dxdy);
-
-    // 3. Applicare un filtro Gaussiano alle tre componenti
-    Mat dx2g, dy2g, dxdyg;
-    GaussianBlur(dx2, dx2g, Size(7, 7), 2.0, 0.0, BORDER_DEFAULT);
-    GaussianBlur(dy2, dy2g, Size(7, 7), 0.0, 2.0, BORDER_DEFAULT);
-    GaussianBlur(dxdy, dxdyg, Size(7, 7), 2.0, 2.0, BORDER_DEFAULT);
-
-    // 4. Calcolare l'indice R
-    Mat det, trace, R;
-    // Calcoliamo il determinante
-    Mat diag1, diag2;
-    multiply(dx2g, dy2g, diag1);
-    multiply(dxdyg, dxdyg, diag2);
-    det = diag1 - diag2;
-    // Calcoliamo la traccia
-    pow(dx2g + dy2g, 2, trace);
-    R = det - k * trace;
-    imshow("R", R);
-    waitKey(0);
+    // 2-4. Componenti della matrice E, filtro Gaussiano 7x7 e indice R in un'unica passata
+    Mat R;
+    harrisResponse(dx, dy, R, k, 7, 2.0);
 
-    // 5. Normalizziamo l'indice R tra [0, 255]
-    normalize(R, R, 0, 255, NORM_MINMAX, CV_8U);
-    imshow("R norm", R);
-    waitKey(0);
+    // 5. Soglia su R equivalente a quella su R normalizzato tra [0, 255]
+    double minR, maxR;
+    minMaxLoc(R, &minR, &maxR);
+    float minResponse = minR + threshold * (maxR - minR) / 255.0;
 
-    // 6. Sogliamo R
-    output = src.clone();
-    for (int i = 0; i < src.rows; i++) {
-        for (int j = 0; j < src.cols; j++) {
-            if (R.at<uchar>(i, j) > threshold) {
-                circle(output, Point(j, i), 6, Scalar(0), 2, 8, 0);
+    // 6. Non maxima suppression 3x3 e selezione dei corner
+    extractCorners(R, corners, minResponse, 1, maxCorners, gridSize);
+}
+
+// Corner in scala: coordinate nell'immagine originale e livello della piramide
+struct ScaleCorner {
+    float x, y;
+    int level;
+    float scale;
+    float response;
+};
+
+/*
+    Harris multiscala. La piramide si costruisce una sola volta con pyrDown
+    e la risposta R di tutti i livelli si calcola in un unico parallel_for_
+    sulle coppie (livello, striscia di righe), così anche i livelli piccoli
+    tengono occupati i core. La soglia, relativa a R normalizzato in
+    [0, 255], usa minimo e massimo di tutti i livelli, in modo che le
+    risposte siano confrontabili. I corner di ogni livello vengono riportati
+    nelle coordinate dell'immagine originale e fusi nello spazio di scala:
+    in ordine di risposta decrescente, un corner viene scartato se ce n'è
+    già uno più forte a un livello adiacente entro 1.5 pixel del livello
+    più grossolano. Se maxCorners > 0 si tengono solo i migliori.
+*/
+void HarrisPyramid(Mat &src, vector<ScaleCorner> &corners, int kernel_size, float k, int threshold, int levels, int maxCorners = 0) {
+    corners.clear();
+
+    /* 1. Piramide e gradienti di ogni livello */
+    vector<Mat> pyr(1, src);
+    while ((int)pyr.size() < levels && pyr.back().rows >= 32 && pyr.back().cols >= 32) {
+        Mat down;
+        pyrDown(pyr.back(), down);
+        pyr.push_back(down);
+    }
+    levels = pyr.size();
+
+    vector<Mat> dx(levels), dy(levels), R(levels);
+    for (int l = 0; l < levels; l++) {
+        Sobel(pyr[l], dx[l], CV_32FC1, 1, 0, kernel_size, BORDER_DEFAULT);
+        Sobel(pyr[l], dy[l], CV_32FC1, 0, 1, kernel_size, BORDER_DEFAULT);
+        R[l].create(pyr[l].rows, pyr[l].cols, CV_32F);
+    }
+
+    /* 2. Risposta di tutti i livelli in parallelo, a strisce di altezza simile */
+    struct Task {
+        int level, y0, y1;
+    };
+    vector<Task> tasks;
+    int stripRows = max(16, src.rows / max(1, getNumThreads() * 2));
+    for (int l = 0; l < levels; l++) {
+        for (int y = 0; y < pyr[l].rows; y += stripRows) {
+            tasks.push_back({l, y, min(pyr[l].rows, y + stripRows)});
+        }
+    }
+    Mat kernel = getGaussianKernel(7, 2.0, CV_32F);
+    parallel_for_(Range(0, tasks.size()), [&](const Range &range) {
+        for (int t = range.start; t < range.end; t++) {
+            const Task &task = tasks[t];
+            harrisResponseRows(dx[task.level], dy[task.level], R[task.level], k, kernel, task.y0, task.y1);
+        }
+    });
+
+    /* 3. Soglia comune e corner di ogni livello nelle coordinate originali */
+    double minR = INFINITY, maxR = -INFINITY;
+    for (int l = 0; l < levels; l++) {
+        double lo, hi;
+        minMaxLoc(R[l], &lo, &hi);
+        minR = min(minR, lo);
+        maxR = max(maxR, hi);
+    }
+    float minResponse = minR + threshold * (maxR - minR) / 255.0;
+
+    vector<Corner> levelCorners;
+    for (int l = 0; l < levels; l++) {
+        extractCorners(R[l], levelCorners, minResponse, 1, 0, 1);
+        float sx = (float)src.cols / pyr[l].cols, sy = (float)src.rows / pyr[l].rows;
+        for (const Corner &c : levelCorners) {
+            corners.push_back({(c.x + 0.5f) * sx - 0.5f, (c.y + 0.5f) * sy - 0.5f, l, sx, c.response});
+        }
+    }
+
+    /* 4. Fusione nello spazio di scala con una griglia dei corner già accettati */
+    sort(corners.begin(), corners.end(), [](const ScaleCorner &a, const ScaleCorner &b) { return a.response > b.response; });
+    float cellSize = 1.5f * (1 << (levels - 1));
+    int gridCols = (int)(src.cols / cellSize) + 1, gridRows = (int)(src.rows / cellSize) + 1;
+    vector<vector<int>> grid(gridCols * gridRows);
+    vector<ScaleCorner> merged;
+    for (const ScaleCorner &c : corners) {
+        int gx = (int)(max(0.0f, c.x) / cellSize), gy = (int)(max(0.0f, c.y) / cellSize);
+        bool suppressed = false;
+        for (int v = max(0, gy - 1); v <= min(gridRows - 1, gy + 1) && !suppressed; v++) {
+            for (int u = max(0, gx - 1); u <= min(gridCols - 1, gx + 1) && !suppressed; u++) {
+                for (int idx : grid[v * gridCols + u]) {
+                    const ScaleCorner &m = merged[idx];
+                    if (abs(m.level - c.level) != 1) continue;
+                    float radius = 1.5f * max(m.scale, c.scale);
+                    float ddx = m.x - c.x, ddy = m.y - c.y;
+                    if (ddx * ddx + ddy * ddy <= radius * radius) {
+                        suppressed = true;
+                        break;
+                    }
+                }
             }
         }
+        if (!suppressed) {
+            grid[gy * gridCols + gx].push_back(merged.size());
+            merged.push_back(c);
+            if (maxCorners > 0 && (int)merged.size() == maxCorners) break;
+        }
+    }
+    corners.swap(merged);
+}
+
+// Disegno dei corner multiscala con un cerchio proporzionale alla scala
+void drawScaleCorners(Mat &img, const vector<ScaleCorner> &corners) {
+    for (const ScaleCorner &c : corners) {
+        circle(img, Point(cvRound(c.x), cvRound(c.y)), cvRound(6 * c.scale), Scalar(0), 2, 8, 0);
+    }
+}
+
+void Harris(Mat &src, Mat &output, int kernel_size, float k, int threshold, int levels = 1) {
+    output = src.clone();
+    if (levels > 1) {
+        vector<ScaleCorner> corners;
+        HarrisPyramid(src, corners, kernel_size, k, threshold, levels);
+        drawScaleCorners(output, corners);
+    }
+    else {
+        vector<Corner> corners;
+        HarrisCorners(src, corners, kernel_size, k, threshold);
+        drawCorners(output, corners);
     }
 }
 
@@ -57,8 +359,8 @@ int main(int argc, char **argv) {
     int kernelSize, threshold;
     float k;
     // Controllo argomenti riga di comando
-    if (argc != 5) {
-        cout << "Usage: " << argv[0] << " image_name kernelSize k threshold" << endl;
+    if (argc != 5 && argc != 7 && argc != 8) {
+        cout << "Usage: " << argv[0] << " image_name kernelSize k threshold [maxCorners gridSize [levels]]" << endl;
         return -1;
     }
 
@@ -73,9 +375,30 @@ int main(int argc, char **argv) {
     k = stof(argv[3]);
     threshold = stoi(argv[4]);
     
-    Mat out;
-    Harris(src, out, kernelSize, k, threshold);
-    
+    int maxCorners = 0, gridSize = 1, levels = 1;
+    if (argc >= 7) {
+        maxCorners = stoi(argv[5]);
+        gridSize = stoi(argv[6]);
+    }
+    if (argc == 8) {
+        levels = stoi(argv[7]);
+    }
+
+    Mat out = src.clone();
+    if (levels > 1) {
+        // Con la piramide la griglia non si usa: i corner sono già fusi tra le scale
+        vector<ScaleCorner> corners;
+        HarrisPyramid(src, corners, kernelSize, k, threshold, levels, maxCorners);
+        cout << "Corners: " << corners.size() << endl;
+        drawScaleCorners(out, corners);
+    }
+    else {
+        vector<Corner> corners;
+        HarrisCorners(src, corners, kernelSize, k, threshold, maxCorners, gridSize);
+        cout << "Corners: " << corners.size() << endl;
+        drawCorners(out, corners);
+    }
+
     imshow("Harris", out);
     waitKey(0);
     return 0;
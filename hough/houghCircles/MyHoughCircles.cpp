@@ -1,64 +1,498 @@
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 using namespace cv;
 
-void houghCircles(Mat src, Mat &out, Mat edgeCanny, int r_min, int r_max, int threshold) {
-    /* 2. Creiamo lo spazio dei voti
-        Lo spazio dei voti sarà matrice tridimensionale dove le prime
-        due dimensioni sono dettate dalla dimensione della matrice
-        di Canny. La terza è il range di valori che variano tra 
-        il raggio minimo e il raggio massimo.
-    */
-    int sizes[] = {edgeCanny.rows, edgeCanny.cols, r_max - r_min + 1};
-    // Allochiamo una matrice tridimensionale, le cui dimensioni sono in sizes
-    // di profondità 8 bit e inizializzata a 0.
-    Mat votes = Mat(3, sizes, CV_8U, Scalar(0));
-
-    /* 3. Per ogni punto di edge (x, y) */
-    for (int x = 0; x < edgeCanny.rows; x++) {
-        for (int y = 0; y < edgeCanny.cols; y++) {
-            if (edgeCanny.at<uchar>(x, y) == 255) {
-                /* 4. Per ogni raggio che varia da r_min ad r_max */
-                for (int radius = r_min; radius <= r_max; radius++) {
-                    /* 5. Per ogni angolo theta che varia da 0 a 360 */
-                    for (int theta = 0; theta < 360; theta++) {
-                        /* 6. Calcola a e b */
-                        int a = y - radius * cos(theta * M_PI / 180);
-                        int b = x - radius * sin(theta * M_PI / 180);
-
-                        // Se le coordinate del centro sono interne all'immagine
-                        if (a >= 0 && a < edgeCanny.cols && b >= 0 && b < edgeCanny.rows) {
-                            /* 7. Effettua la votazione */
-                            votes.at<uchar>(b, a, radius - r_min)++;
+// Cerchio individuato: centro, raggio e voti ricevuti
+struct HoughCircle {
+    Point center;
+    int radius;
+    int votes;
+};
+
+// Disegno dei cerchi: centro di raggio 3 px e circonferenza
+void drawCircles(Mat &img, const vector<HoughCircle> &circles) {
+    for (const HoughCircle &c : circles) {
+        circle(img, c.center, 3, Scalar(0), 2, 8, 0);
+        circle(img, c.center, c.radius, Scalar(0), 2, 8, 0);
+    }
+}
+
+/*
+    Circonferenza digitale di raggio radius, come spostamenti dal centro:
+    un ottante con l'algoritmo del punto medio (solo somme intere) e gli
+    altri sette per simmetria, senza i punti ripetuti sugli assi e sulle
+    diagonali. Ogni pixel della circonferenza compare una volta sola, quindi
+    i voti di un punto sono tanti quanti i pixel della circonferenza vera:
+    niente voti doppi per i raggi piccoli né buchi per quelli grandi.
+    Gli spostamenti sono ordinati per riga per scrivere l'accumulatore
+    una riga alla volta; linear è lo stesso spostamento come indice in un
+    piano con step elementi per riga e gli spostamenti con dy = k iniziano
+    all'indice rowStart[k + radius].
+*/
+struct CircleTable {
+    int radius;
+    vector<Point> offsets;
+    vector<int> linear;
+    vector<int> rowStart;
+};
+
+CircleTable makeCircleTable(int radius, int step) {
+    CircleTable table;
+    table.radius = radius;
+    vector<Point> &offsets = table.offsets;
+    int x = radius, y = 0, err = 1 - radius;
+    while (x >= y) {
+        Point octant[] = {Point(x, y), Point(y, x), Point(-y, x), Point(-x, y),
+                          Point(-x, -y), Point(-y, -x), Point(y, -x), Point(x, -y)};
+        offsets.insert(offsets.end(), octant, octant + 8);
+        y++;
+        if (err < 0) {
+            err += 2 * y + 1;
+        }
+        else {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+    sort(offsets.begin(), offsets.end(), [](Point p, Point q) {
+        return p.y != q.y ? p.y < q.y : p.x < q.x;
+    });
+    offsets.erase(unique(offsets.begin(), offsets.end(), [](Point p, Point q) {
+        return p.x == q.x && p.y == q.y;
+    }), offsets.end());
+
+    for (const Point &o : offsets) {
+        table.linear.push_back(o.y * step + o.x);
+    }
+    table.rowStart.assign(2 * radius + 2, 0);
+    for (const Point &o : offsets) {
+        table.rowStart[o.y + radius + 1]++;
+    }
+    for (int k = 1; k < (int)table.rowStart.size(); k++) {
+        table.rowStart[k] += table.rowStart[k - 1];
+    }
+    return table;
+}
+
+/*
+    Votazione delle righe [y0, y1) di un piano dell'accumulatore (CV_32S,
+    continuo) per il raggio della tabella: ogni punto di edge vota i centri
+    sulla circonferenza digitale attorno a sé. Contribuiscono solo i punti
+    entro il raggio dalla striscia (i punti sono in ordine di riga, come
+    li restituisce findNonZero) e per ciascuno solo gli spostamenti che
+    cadono nelle righe della striscia, che nella tabella sono contigui:
+    così le strisce si possono votare in parallelo senza sovrapporsi. I
+    punti a distanza almeno pari al raggio dai bordi destro e sinistro
+    votano con i soli indici lineari, senza controlli; gli altri
+    controllano la colonna di ogni centro.
+*/
+void voteRadius(const vector<Point> &points, const CircleTable &table, Mat &plane, int y0, int y1) {
+    int r = table.radius;
+    auto byRow = [](const Point &p, int y) { return p.y < y; };
+    auto first = lower_bound(points.begin(), points.end(), y0 - r, byRow);
+    auto last = lower_bound(first, points.end(), y1 + r, byRow);
+    for (auto it = first; it != last; ++it) {
+        const Point &p = *it;
+        int k0 = table.rowStart[max(y0 - p.y, -r) + r];
+        int k1 = table.rowStart[min(y1 - p.y, r + 1) + r];
+        int *center = plane.ptr<int>(p.y) + p.x;
+        if (p.x >= r && p.x < plane.cols - r) {
+            for (int k = k0; k < k1; k++) {
+                center[table.linear[k]]++;
+            }
+        }
+        else {
+            for (int k = k0; k < k1; k++) {
+                // Se le coordinate del centro sono interne all'immagine
+                int a = p.x + table.offsets[k].x;
+                if (a >= 0 && a < plane.cols) {
+                    center[table.linear[k]]++;
+                }
+            }
+        }
+    }
+}
+
+/*
+    Picchi di una banda di raggi: acc contiene nPlanes piani consecutivi
+    a partire dal raggio rLow e si cercano, nei piani [i0, i1) e per i
+    centri nelle righe [b0, b1), i voti (a, b, r) sopra la soglia che sono
+    massimi nell'intorno 3x3x3. I piani fuori da [i0, i1) sono i raggi
+    vicini delle bande adiacenti e servono solo per il confronto.
+*/
+void bandPeaks(const Mat &acc, int rows, int rLow, int nPlanes, int i0, int i1, int threshold, int b0, int b1, vector<HoughCircle> &peaks) {
+    for (int i = i0; i < i1; i++) {
+        for (int b = b0; b < b1; b++) {
+            const int *cur = acc.ptr<int>(i * rows + b);
+            for (int a = 0; a < acc.cols; a++) {
+                int v = cur[a];
+                if (v <= threshold) continue;
+                bool isMax = true;
+                for (int di = max(0, i - 1); di <= min(nPlanes - 1, i + 1) && isMax; di++) {
+                    for (int db = max(0, b - 1); db <= min(rows - 1, b + 1) && isMax; db++) {
+                        const int *row = acc.ptr<int>(di * rows + db);
+                        for (int da = max(0, a - 1); da <= min(acc.cols - 1, a + 1); da++) {
+                            // A parità di voti vince il primo in ordine (r, b, a)
+                            int w = row[da];
+                            bool before = di < i || (di == i && (db < b || (db == b && da < a)));
+                            if (w > v || (w == v && before)) {
+                                isMax = false;
+                                break;
+                            }
                         }
                     }
                 }
+                if (isMax) {
+                    peaks.push_back({Point(a, b), rLow + i, v});
+                }
             }
         }
     }
-    out = src.clone();
-    /* 7. Andiamo a prendere i valori (a, b, r) maggiori di una certa soglia */
-    for (int r = r_min; r < r_max; r++) {
-        for (int b = 0; b < edgeCanny.rows; b++) {
-            for (int a = 0; a < edgeCanny.cols; a++) {
-                if (votes.at<uchar>(b, a, r - r_min) > threshold) {
-                    // La prima chiamata disegna il centro del cerchio, di raggio 3 px
-                    circle(out, Point(a, b), 3, Scalar(0), 2, 8, 0);
-                    // La seconda chiamata disegna il cerchio effettivo
-                    circle(out, Point(a, b), r, Scalar(0), 2, 8, 0);
+}
+
+// Cerchi in ordine di voti decrescenti
+void sortByVotes(vector<HoughCircle> &circles) {
+    stable_sort(circles.begin(), circles.end(), [](const HoughCircle &p, const HoughCircle &q) {
+        return p.votes > q.votes;
+    });
+}
+
+// Memoria massima per i piani dei voti (rows x cols a 32 bit) vivi insieme
+const size_t CIRCLE_ACC_BYTES = (size_t)128 << 20;
+// Raggi minimi di una banda per worker: i due piani vicini costano al più il 25% di voti in più
+const int MIN_CIRCLE_BAND = 8;
+
+/*
+    Trasformata di Hough per i cerchi nello spazio (a, b, r), senza tenere
+    in memoria tutto il volume dei voti: i raggi sono divisi in bande di
+    bandSize raggi e ogni banda viene votata in un accumulatore 2D per
+    raggio (piani rows x cols a 32 bit, quindi senza overflow), da cui si
+    estraggono i picchi prima di passare alla banda successiva. Ogni banda
+    vota anche il raggio precedente e quello successivo, così i picchi sui
+    raggi estremi della banda si confrontano con tutto il loro intorno e il
+    risultato non dipende da bandSize; quei due piani sono voti ripetuti,
+    quindi le bande sono le più larghe che il budget permette.
+
+    I piani vivi in ogni momento occupano al più CIRCLE_ACC_BYTES (almeno
+    tre piani), qualunque siano r_max - r_min e il numero di thread; il
+    lavoro si divide tra i thread senza sincronizzazione né accumulatori
+    da ridurre:
+    - per bande, se ogni thread può tenere nel budget il proprio
+      accumulatore per una banda di almeno MIN_CIRCLE_BAND raggi (immagini
+      piccole o intervalli di raggi ampi): ogni worker alloca una volta il
+      proprio accumulatore e prende le bande una alla volta da un contatore
+      condiviso, così quelli liberi prendono le successive;
+    - per strisce, in tutti gli altri casi: le bande, di tutti i piani del
+      budget tranne i due vicini, si elaborano una alla volta in un
+      accumulatore condiviso, diviso in strisce di righe: ogni striscia
+      riceve i voti dei punti entro r_max dalle sue righe e scrive solo
+      nelle sue righe. Le strisce sono più dei worker, così quelli liberi
+      prendono le successive quando la densità degli edge non è uniforme.
+*/
+void houghCircles(const Mat &edgeCanny, vector<HoughCircle> &circles, int r_min, int r_max, int threshold) {
+    vector<Point> points;
+    findNonZero(edgeCanny, points);
+
+    // Tabelle delle circonferenze, una volta sola per tutti i raggi
+    vector<CircleTable> tables;
+    for (int r = r_min; r <= r_max; r++) {
+        tables.push_back(makeCircleTable(r, edgeCanny.cols));
+    }
+
+    int rows = edgeCanny.rows;
+    int nRadii = r_max - r_min + 1;
+    size_t planeBytes = (size_t)rows * edgeCanny.cols * sizeof(int);
+    int maxPlanes = (int)min<size_t>(max<size_t>(3, CIRCLE_ACC_BYTES / planeBytes), nRadii + 2);
+    int nThreads = max(1, getNumThreads());
+    // Banda di ogni worker: almeno una per thread, con i due piani vicini nel budget
+    int bandSize = min(maxPlanes / nThreads - 2, nRadii / nThreads);
+    bool byBands = bandSize >= MIN_CIRCLE_BAND;
+    if (!byBands) {
+        // Un solo accumulatore condiviso: la banda più larga che sta nel budget
+        bandSize = maxPlanes - 2;
+    }
+    int nBands = (nRadii + bandSize - 1) / bandSize;
+    vector<vector<HoughCircle>> bandCircles(nBands);
+    if (byBands) {
+        // Partizione per bande di raggi
+        int nWorkers = nThreads;
+        atomic<int> nextBand(0);
+        parallel_for_(Range(0, nWorkers), [&](const Range &range) {
+            for (int w = range.start; w < range.end; w++) {
+                Mat acc((bandSize + 2) * rows, edgeCanny.cols, CV_32S);
+                for (int band = nextBand++; band < nBands; band = nextBand++) {
+                    int r0 = r_min + band * bandSize, r1 = min(r0 + bandSize, r_max + 1);
+                    // Raggi votati, compresi quelli vicini delle bande adiacenti
+                    int rLow = max(r_min, r0 - 1), nPlanes = min(r_max, r1) - rLow + 1;
+                    acc = Scalar(0);
+                    for (int i = 0; i < nPlanes; i++) {
+                        Mat plane = acc.rowRange(i * rows, (i + 1) * rows);
+                        voteRadius(points, tables[rLow + i - r_min], plane, 0, rows);
+                    }
+                    bandPeaks(acc, rows, rLow, nPlanes, r0 - rLow, r1 - rLow, threshold, 0, rows, bandCircles[band]);
                 }
             }
+        }, nWorkers);
+    }
+    else {
+        // Partizione per strisce di righe dell'immagine
+        int nStrips = max(1, min(rows, nThreads * 4));
+        Mat acc((bandSize + 2) * rows, edgeCanny.cols, CV_32S);
+        vector<vector<HoughCircle>> stripPeaks(nStrips);
+        for (int band = 0; band < nBands; band++) {
+            int r0 = r_min + band * bandSize, r1 = min(r0 + bandSize, r_max + 1);
+            int rLow = max(r_min, r0 - 1), nPlanes = min(r_max, r1) - rLow + 1;
+            acc = Scalar(0);
+            parallel_for_(Range(0, nStrips), [&](const Range &range) {
+                for (int s = range.start; s < range.end; s++) {
+                    int y0 = rows * s / nStrips, y1 = rows * (s + 1) / nStrips;
+                    for (int i = 0; i < nPlanes; i++) {
+                        Mat plane = acc.rowRange(i * rows, (i + 1) * rows);
+                        voteRadius(points, tables[rLow + i - r_min], plane, y0, y1);
+                    }
+                }
+            }, nStrips);
+            // I picchi leggono anche le righe vicine: si cercano a votazione finita
+            parallel_for_(Range(0, nStrips), [&](const Range &range) {
+                for (int s = range.start; s < range.end; s++) {
+                    stripPeaks[s].clear();
+                    bandPeaks(acc, rows, rLow, nPlanes, r0 - rLow, r1 - rLow, threshold, rows * s / nStrips, rows * (s + 1) / nStrips, stripPeaks[s]);
+                }
+            }, nStrips);
+            for (const vector<HoughCircle> &sp : stripPeaks) {
+                bandCircles[band].insert(bandCircles[band].end(), sp.begin(), sp.end());
+            }
+        }
+    }
+
+    circles.clear();
+    for (const vector<HoughCircle> &bc : bandCircles) {
+        circles.insert(circles.end(), bc.begin(), bc.end());
+    }
+    sortByVotes(circles);
+}
+
+/*
+    Trasformata di Hough per i cerchi con raggio noto a meno di pochi
+    pixel: per ogni raggio l'accumulatore è la correlazione della mappa
+    degli edge con l'anello della circonferenza digitale (lo stesso della
+    votazione standard, quindi con gli stessi voti), calcolata con la DFT.
+    Lo spettro degli edge si calcola una volta e si riusa per tutti i
+    raggi; per ogni raggio servono la DFT dell'anello, il prodotto degli
+    spettri e la DFT inversa, con un costo che non dipende dal numero di
+    punti di edge. Le immagini sono allargate di r_max righe e colonne
+    (alla dimensione ottima per la DFT) perché la correlazione circolare
+    non riporti sul bordo opposto i voti dei centri fuori dall'immagine.
+    Dei piani dei voti se ne tengono solo tre (raggio precedente, corrente
+    e successivo): i picchi di un raggio si cercano appena è pronto il
+    piano del raggio successivo, quindi la memoria non cresce con r_max - r_min.
+*/
+void houghCirclesFFT(const Mat &edgeCanny, vector<HoughCircle> &circles, int r_min, int r_max, int threshold) {
+    int rows = edgeCanny.rows, cols = edgeCanny.cols;
+    int dftRows = getOptimalDFTSize(rows + r_max), dftCols = getOptimalDFTSize(cols + r_max);
+
+    // Spettro degli edge (valori 0/1), riusato per tutti i raggi
+    Mat padded = Mat::zeros(dftRows, dftCols, CV_32F), edgeSpectrum;
+    Mat roi = padded(Rect(0, 0, cols, rows));
+    edgeCanny.convertTo(roi, CV_32F, 1.0 / 255);
+    dft(padded, edgeSpectrum, 0, rows);
+
+    int nRadii = r_max - r_min + 1;
+    // Finestra di nPlanes piani consecutivi a partire dal raggio rLow
+    Mat window(3 * rows, cols, CV_32S);
+    int nPlanes = 0, rLow = r_min;
+    Mat ring(dftRows, dftCols, CV_32F), ringSpectrum, product, response;
+    circles.clear();
+    for (int i = 0; i <= nRadii; i++) {
+        // Il raggio r_min + i - 1 è completo quando c'è il successivo (o è l'ultimo)
+        if (i == nRadii) {
+            int c = r_min + i - 1 - rLow;
+            bandPeaks(window, rows, rLow, nPlanes, c, c + 1, threshold, 0, rows, circles);
+            break;
+        }
+
+        // Finestra piena: si scarta il piano più vecchio
+        if (nPlanes == 3) {
+            for (int k = 0; k < 2; k++) {
+                Mat dst = window.rowRange(k * rows, (k + 1) * rows);
+                window.rowRange((k + 1) * rows, (k + 2) * rows).copyTo(dst);
+            }
+            nPlanes = 2;
+            rLow++;
+        }
+
+        /* Anello centrato nell'origine (simmetrico, quindi correlazione e
+           convoluzione coincidono): gli spostamenti negativi si riportano
+           in fondo, come richiede la DFT */
+        CircleTable table = makeCircleTable(r_min + i, dftCols);
+        ring = Scalar(0);
+        for (const Point &o : table.offsets) {
+            ring.at<float>((o.y + dftRows) % dftRows, (o.x + dftCols) % dftCols) = 1;
+        }
+        dft(ring, ringSpectrum);
+        mulSpectrums(edgeSpectrum, ringSpectrum, product, 0);
+        dft(product, response, DFT_INVERSE | DFT_SCALE | DFT_REAL_OUTPUT, rows);
+
+        // Voti interi: l'errore della DFT in float è ben sotto 0.5
+        Mat plane = window.rowRange(nPlanes * rows, (nPlanes + 1) * rows);
+        response(Rect(0, 0, cols, rows)).convertTo(plane, CV_32S);
+        nPlanes++;
+
+        if (i >= 1) {
+            int c = r_min + i - 1 - rLow;
+            bandPeaks(window, rows, rLow, nPlanes, c, c + 1, threshold, 0, rows, circles);
+        }
+    }
+    sortByVotes(circles);
+}
+
+/*
+    Stima del raggio di un centro candidato: istogramma radiale delle
+    distanze (arrotondate) dei punti di edge dal centro, tra r_min e r_max.
+    Una circonferenza digitale sottile di raggio r (come un bordo di Canny
+    o le tabelle del punto medio) ha circa 4 * sqrt(2) * r pixel, non
+    2 * pi * r: la copertura si normalizza su questo valore, così un cerchio
+    completo vale circa 1. Si sceglie il raggio con la copertura più alta
+    e lo si accetta se supera minCoverage. I punti sono in ordine di riga
+    (come li restituisce findNonZero): si scorrono solo quelli delle righe
+    [center.y - r_max, center.y + r_max], come in voteRadius.
+*/
+bool estimateRadius(const vector<Point> &points, Point center, int r_min, int r_max, double minCoverage, vector<int> &hist, HoughCircle &found) {
+    fill(hist.begin(), hist.end(), 0);
+    int r2min = r_min * r_min, r2max = r_max * r_max;
+    auto byRow = [](const Point &p, int y) { return p.y < y; };
+    auto first = lower_bound(points.begin(), points.end(), center.y - r_max, byRow);
+    auto last = lower_bound(first, points.end(), center.y + r_max + 1, byRow);
+    for (auto it = first; it != last; ++it) {
+        const Point &p = *it;
+        int dx = p.x - center.x, dy = p.y - center.y;
+        if (abs(dx) > r_max) continue;
+        int d2 = dx * dx + dy * dy;
+        if (d2 < r2min || d2 > r2max) continue;
+        int r = cvRound(sqrt((double)d2));
+        if (r <= r_max) hist[r - r_min]++;
+    }
+
+    double bestCoverage = 0;
+    for (int r = r_min; r <= r_max; r++) {
+        double coverage = hist[r - r_min] / (4 * sqrt(2.0) * r);
+        if (coverage > bestCoverage) {
+            bestCoverage = coverage;
+            found.radius = r;
+            found.votes = hist[r - r_min];
+        }
+    }
+    found.center = center;
+    return bestCoverage >= minCoverage;
+}
+
+/*
+    Trasformata di Hough "2-1" per i cerchi. Il centro di un cerchio giace
+    sulla retta del gradiente di ogni suo punto di edge, a distanza pari al
+    raggio: ogni punto vota quindi i soli centri lungo il gradiente (nei due
+    versi) per r in [r_min, r_max], in un accumulatore 2D intero grande
+    quanto l'immagine. I massimi locali sopra centerThreshold sono i centri
+    candidati, dal più votato; per ciascuno il raggio viene dall'istogramma
+    radiale e si scartano i centri a meno di minDist da un cerchio già
+    trovato. Memoria O(rows * cols); tempo O(edge * (r_max - r_min)) per il
+    voto più, per ogni centro, i soli punti di edge nelle 2 * r_max + 1
+    righe attorno al centro.
+*/
+void houghCirclesGradient(const Mat &src, const Mat &edgeCanny, vector<HoughCircle> &circles, int r_min, int r_max, int centerThreshold, double minCoverage = 0.5, int minDist = 0) {
+    const int shift = 10;
+    circles.clear();
+
+    // Gradiente con lo stesso Sobel 3x3 usato da Canny
+    Mat dx, dy;
+    Sobel(src, dx, CV_16S, 1, 0, 3);
+    Sobel(src, dy, CV_16S, 0, 1, 3);
+
+    vector<Point> points;
+    findNonZero(edgeCanny, points);
+
+    /* Votazione dei centri: il passo lungo il gradiente normalizzato è in
+       virgola fissa, così ogni voto costa due somme intere */
+    Mat votes = Mat::zeros(edgeCanny.rows, edgeCanny.cols, CV_32S);
+    for (const Point &p : points) {
+        int gx = dx.at<short>(p), gy = dy.at<short>(p);
+        if (gx == 0 && gy == 0) continue;
+        double mag = sqrt((double)gx * gx + (double)gy * gy);
+        int sx = cvRound(gx * (1 << shift) / mag);
+        int sy = cvRound(gy * (1 << shift) / mag);
+        int x0 = (p.x << shift) + (1 << (shift - 1));
+        int y0 = (p.y << shift) + (1 << (shift - 1));
+
+        for (int k = 0; k < 2; k++) {
+            int x = x0 + sx * r_min, y = y0 + sy * r_min;
+            for (int r = r_min; r <= r_max; r++, x += sx, y += sy) {
+                int a = x >> shift, b = y >> shift;
+                // Ci si allontana dal punto: uscito dall'immagine non si rientra più
+                if (a < 0 || a >= votes.cols || b < 0 || b >= votes.rows) break;
+                votes.ptr<int>(b)[a]++;
+            }
+            sx = -sx;
+            sy = -sy;
+        }
+    }
+
+    /* Centri candidati: massimi locali 3x3 sopra la soglia, confrontati con
+       tutti gli 8 vicini; a parità di voti vince il primo in ordine di riga */
+    vector<Point> centers;
+    for (int b = 1; b < votes.rows - 1; b++) {
+        const int *prev = votes.ptr<int>(b - 1), *cur = votes.ptr<int>(b), *next = votes.ptr<int>(b + 1);
+        for (int a = 1; a < votes.cols - 1; a++) {
+            int v = cur[a];
+            if (v > centerThreshold &&
+                v > prev[a - 1] && v > prev[a] && v > prev[a + 1] && v > cur[a - 1] &&
+                v >= cur[a + 1] && v >= next[a - 1] && v >= next[a] && v >= next[a + 1]) {
+                centers.push_back(Point(a, b));
+            }
+        }
+    }
+    sort(centers.begin(), centers.end(), [&votes](Point p, Point q) {
+        int vp = votes.at<int>(p), vq = votes.at<int>(q);
+        return vp != vq ? vp > vq : (p.y != q.y ? p.y < q.y : p.x < q.x);
+    });
+
+    // Raggio di ogni centro dall'istogramma radiale
+    vector<int> hist(r_max - r_min + 1);
+    int minDist2 = minDist * minDist;
+    for (Point c : centers) {
+        bool near = false;
+        for (const HoughCircle &f : circles) {
+            int ddx = f.center.x - c.x, ddy = f.center.y - c.y;
+            if (ddx * ddx + ddy * ddy < minDist2) {
+                near = true;
+                break;
+            }
+        }
+        if (near) continue;
+
+        HoughCircle found;
+        if (estimateRadius(points, c, r_min, r_max, minCoverage, hist, found)) {
+            circles.push_back(found);
         }
     }
 }
 
 int main(int argc, char **argv) {
     // Controllo argomenti riga di comando
-    if (argc != 2) {
-        cout << "Usage: " << argv[0] << " image_name" << endl;
+    if (argc != 2 && argc != 3 && argc != 6) {
+        cout << "Usage: " << argv[0] << " image_name [standard|gradient|fft [r_min r_max threshold]]" << endl;
+        return -1;
+    }
+
+    /* Modalità: spazio (a, b, r) per bande di raggi (standard), votazione
+       lungo il gradiente (gradient) o correlazione con la DFT per pochi raggi (fft) */
+    String mode = (argc >= 3) ? String(argv[2]) : "standard";
+    if (mode != "standard" && mode != "gradient" && mode != "fft") {
+        cout << "Unknown mode " << mode << endl;
         return -1;
     }
 
@@ -78,13 +512,32 @@ int main(int argc, char **argv) {
     imshow("Canny", edgeCanny);
     waitKey(0);
 
-    int r_min = 40;
-    int r_max = 90;
-    int threshold = 140;
-    
-    Mat out;
-    houghCircles(src, out, edgeCanny, r_min, r_max, threshold);
-    
+    int r_min = (argc == 6) ? stoi(argv[3]) : 40;
+    int r_max = (argc == 6) ? stoi(argv[4]) : 90;
+    // Nella modalità gradient è la soglia sui voti dei centri
+    int threshold = (argc == 6) ? stoi(argv[5]) : (mode == "gradient" ? 40 : 140);
+    if (r_min < 1 || r_max < r_min) {
+        cout << "Invalid radius range" << endl;
+        return -1;
+    }
+
+    vector<HoughCircle> circles;
+    if (mode == "gradient") {
+        houghCirclesGradient(src, edgeCanny, circles, r_min, r_max, threshold, 0.5, r_min);
+    }
+    else if (mode == "fft") {
+        houghCirclesFFT(edgeCanny, circles, r_min, r_max, threshold);
+    }
+    else {
+        houghCircles(edgeCanny, circles, r_min, r_max, threshold);
+    }
+    for (const HoughCircle &c : circles) {
+        cout << "center: (" << c.center.x << ", " << c.center.y << ") radius: " << c.radius << " votes: " << c.votes << endl;
+    }
+
+    Mat out = src.clone();
+    drawCircles(out, circles);
+
     imshow("output", out);
     waitKey(0);
     
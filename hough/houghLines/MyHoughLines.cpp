@@ -1,66 +1,428 @@
 #include <opencv2/opencv.hpp>
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 using namespace cv;
 
-void houghLines(Mat src, Mat &out, Mat edgeCanny, int threshold) {
+/*
+    Spazio dei voti delle rette rho = x * cos(theta) + y * sin(theta), con
+    theta in [-90, 90) gradi campionato ogni thetaRes gradi e rho campionato
+    ogni rhoRes pixel. Seno e coseno sono precalcolati una volta sola in
+    virgola fissa (scalati per 2^shift / rhoRes), così il voto di un pixel
+    per un angolo è una moltiplicazione-somma intera a 64 bit e uno shift.
+    Con shift = 20 l'errore di arrotondamento delle tabelle resta sotto
+    0.05 bin di rho anche a 40000 pixel dall'origine.
+*/
+struct HoughLineSpace {
+    double rhoRes, thetaRes;
+    int nRho, nTheta;
+    // Indice di rho = 0
+    int rhoOffset;
+    int shift;
+    // Offset di rho e arrotondamento al più vicino prima dello shift
+    int64 bias;
+    vector<int> cosQ, sinQ;
+    vector<double> theta;
+};
+
+HoughLineSpace makeLineSpace(int rows, int cols, double rhoRes, double thetaRes) {
+    HoughLineSpace space;
+    space.rhoRes = rhoRes;
+    space.thetaRes = thetaRes;
+    // Distanza massima tra due punti nell'immagine
+    double dist = hypot(rows, cols);
+    space.rhoOffset = cvCeil(dist / rhoRes);
+    space.nRho = 2 * space.rhoOffset + 1;
+    space.nTheta = cvRound(180.0 / thetaRes);
+
+    space.shift = 20;
+    space.bias = ((int64)space.rhoOffset << space.shift) + ((int64)1 << (space.shift - 1));
+
+    space.cosQ.resize(space.nTheta);
+    space.sinQ.resize(space.nTheta);
+    space.theta.resize(space.nTheta);
+    double scale = (1 << space.shift) / rhoRes;
+    for (int t = 0; t < space.nTheta; t++) {
+        // (theta - 90) poiché l'intervallo di theta varia da -90 a 90
+        space.theta[t] = (t * thetaRes - 90) * CV_PI / 180;
+        space.cosQ[t] = cvRound(cos(space.theta[t]) * scale);
+        space.sinQ[t] = cvRound(sin(space.theta[t]) * scale);
+    }
+    return space;
+}
+
+/*
+    Raccolta delle coordinate dei pixel di edge, che di solito sono pochi
+    punti percentuali dell'immagine: le strisce di righe sono scandite in
+    parallelo con findNonZero (vettorizzata in OpenCV) e le liste
+    concatenate nell'ordine delle righe.
+*/
+void collectEdgePoints(const Mat &edgeCanny, vector<Point> &points) {
+    int nStrips = max(1, min(edgeCanny.rows, getNumThreads() * 2));
+    vector<vector<Point>> stripPoints(nStrips);
+    parallel_for_(Range(0, nStrips), [&](const Range &range) {
+        for (int s = range.start; s < range.end; s++) {
+            int y0 = edgeCanny.rows * s / nStrips, y1 = edgeCanny.rows * (s + 1) / nStrips;
+            if (y0 == y1) continue;
+            findNonZero(edgeCanny.rowRange(y0, y1), stripPoints[s]);
+            for (Point &p : stripPoints[s]) {
+                p.y += y0;
+            }
+        }
+    });
+
+    points.clear();
+    for (const vector<Point> &sp : stripPoints) {
+        points.insert(points.end(), sp.begin(), sp.end());
+    }
+}
+
+/*
+    Votazione nell'accumulatore a 32 bit: a differenza di quello a 8 bit
+    non ricomincia da zero dopo 255 voti, quindi le rette lunghe nelle
+    immagini grandi non spariscono. L'accumulatore (CV_32S) ha una riga
+    per ogni theta e una colonna per ogni rho: ogni thread vota per un
+    intervallo di theta con tutti i punti di edge, quindi scrive solo nelle
+    proprie righe, senza copie private da ridurre né sincronizzazione, e la
+    riga di un theta resta in cache mentre si scorrono i punti.
+*/
+void voteLines(const vector<Point> &points, const HoughLineSpace &space, Mat &votes) {
+    votes = Mat::zeros(space.nTheta, space.nRho, CV_32S);
+    int64 bias = space.bias;
+
+    parallel_for_(Range(0, space.nTheta), [&](const Range &range) {
+        for (int t = range.start; t < range.end; t++) {
+            int *acc = votes.ptr<int>(t);
+            int c = space.cosQ[t], sn = space.sinQ[t];
+            for (const Point &p : points) {
+                acc[((int64)p.x * c + (int64)p.y * sn + bias) >> space.shift]++;
+            }
+        }
+    }, getNumThreads() * 4);
+}
+
+/*
+    Votazione vincolata dal gradiente. La normale di una retta ha la stessa
+    direzione del gradiente nei suoi punti di edge, quindi ogni punto vota
+    solo per i theta entro windowBins campioni dal suo angolo di gradiente
+    (theta è periodico di 180 gradi: si prosegue dall'altro capo). I punti
+    sono ordinati per campione di theta con un counting sort, così ogni
+    thread, per i theta che gli spettano, scorre solo i secchi dei punti
+    che possono votarli e resta l'unico a scrivere nelle proprie righe.
+    orientation è l'angolo del gradiente in gradi (CV_32F, come phase()).
+*/
+void voteLinesOriented(const vector<Point> &points, const Mat &orientation, const HoughLineSpace &space, int windowBins, Mat &votes) {
+    int nTheta = space.nTheta;
+    votes = Mat::zeros(nTheta, space.nRho, CV_32S);
+    int64 bias = space.bias;
+
+    // Campione di theta della normale di ogni punto, riportato in [-90, 90)
+    vector<int> bin(points.size());
+    vector<int> bucketStart(nTheta + 1, 0);
+    for (size_t i = 0; i < points.size(); i++) {
+        double a = fmod(orientation.at<float>(points[i].y, points[i].x) + 90.0, 180.0);
+        if (a < 0) a += 180.0;
+        int b = cvRound(a / space.thetaRes) % nTheta;
+        bin[i] = b;
+        bucketStart[b + 1]++;
+    }
+    for (int b = 0; b < nTheta; b++) {
+        bucketStart[b + 1] += bucketStart[b];
+    }
+    vector<Point> sorted(points.size());
+    vector<int> pos(bucketStart.begin(), bucketStart.end() - 1);
+    for (size_t i = 0; i < points.size(); i++) {
+        sorted[pos[bin[i]]++] = points[i];
+    }
+
+    // Una finestra più larga di mezzo giro equivale a votare per tutti i theta
+    windowBins = min(windowBins, (nTheta - 1) / 2);
+    parallel_for_(Range(0, nTheta), [&](const Range &range) {
+        for (int t = range.start; t < range.end; t++) {
+            int *acc = votes.ptr<int>(t);
+            int c = space.cosQ[t], sn = space.sinQ[t];
+            for (int d = -windowBins; d <= windowBins; d++) {
+                int b = (t + d + nTheta) % nTheta;
+                for (int i = bucketStart[b]; i < bucketStart[b + 1]; i++) {
+                    acc[((int64)sorted[i].x * c + (int64)sorted[i].y * sn + bias) >> space.shift]++;
+                }
+            }
+        }
+    }, getNumThreads() * 4);
+}
+
+// Retta individuata: parametri (rho, theta in radianti) e numero di voti
+struct HoughLine {
+    double rho, theta;
+    int votes;
+};
+
+/*
+    Voti della cella vicina (t + dt, r + dr). theta è periodico: oltre
+    i 90 gradi si rientra da -90 con rho cambiato di segno, quindi una
+    retta quasi verticale ha i suoi vicini anche all'altro capo.
+    Restituisce -1 fuori dallo spazio dei voti; in idx l'indice lineare della cella.
+*/
+static inline int neighbourVotes(const Mat &votes, const HoughLineSpace &space, int t, int r, int &idx) {
+    if (t < 0 || t >= space.nTheta) {
+        t = (t + space.nTheta) % space.nTheta;
+        r = 2 * space.rhoOffset - r;
+    }
+    if (r < 0 || r >= space.nRho) return -1;
+    idx = t * space.nRho + r;
+    return votes.ptr<int>(t)[r];
+}
+
+/*
+    Estrae i picchi dell'accumulatore: una cella è un picco se ha almeno
+    threshold voti ed è il massimo nella finestra (2 * nmsRadius + 1)^2
+    (a parità di voti vince la cella con indice minore), così le celle
+    vicine della stessa retta non vengono riportate più volte. Se
+    maxLines > 0 si tengono solo i maxLines picchi più votati, con un heap
+    limitato per ogni striscia di theta. Le rette sono in ordine di voti decrescente.
+*/
+void findLinePeaks(const Mat &votes, const HoughLineSpace &space, int threshold, int nmsRadius, int maxLines, vector<HoughLine> &lines) {
+    auto stronger = [](const HoughLine &a, const HoughLine &b) { return a.votes > b.votes; };
+    int nStrips = max(1, min(space.nTheta, getNumThreads() * 2));
+    vector<vector<HoughLine>> stripLines(nStrips);
+
+    parallel_for_(Range(0, nStrips), [&](const Range &range) {
+        for (int s = range.start; s < range.end; s++) {
+            vector<HoughLine> &heap = stripLines[s];
+            int t0 = space.nTheta * s / nStrips, t1 = space.nTheta * (s + 1) / nStrips;
+            for (int t = t0; t < t1; t++) {
+                const int *row = votes.ptr<int>(t);
+                for (int r = 0; r < space.nRho; r++) {
+                    int v = row[r];
+                    if (v < threshold) continue;
+                    int self = t * space.nRho + r;
+                    bool isMax = true;
+                    for (int dt = -nmsRadius; dt <= nmsRadius && isMax; dt++) {
+                        for (int dr = -nmsRadius; dr <= nmsRadius; dr++) {
+                            int idx = -1;
+                            int n = neighbourVotes(votes, space, t + dt, r + dr, idx);
+                            if (idx == self) continue;
+                            if (n > v || (n == v && idx < self)) {
+                                isMax = false;
+                                break;
+                            }
+                        }
+                    }
+                    if (!isMax) continue;
+
+                    HoughLine l = {(r - space.rhoOffset) * space.rhoRes, space.theta[t], v};
+                    // Con stronger come confronto in cima all'heap c'è la retta meno votata
+                    if (maxLines <= 0 || (int)heap.size() < maxLines) {
+                        heap.push_back(l);
+                        if (maxLines > 0) push_heap(heap.begin(), heap.end(), stronger);
+                    }
+                    else if (v > heap.front().votes) {
+                        pop_heap(heap.begin(), heap.end(), stronger);
+                        heap.back() = l;
+                        push_heap(heap.begin(), heap.end(), stronger);
+                    }
+                }
+            }
+        }
+    });
+
+    lines.clear();
+    for (const vector<HoughLine> &sl : stripLines) {
+        lines.insert(lines.end(), sl.begin(), sl.end());
+    }
+    sort(lines.begin(), lines.end(), stronger);
+    if (maxLines > 0 && (int)lines.size() > maxLines) {
+        lines.resize(maxLines);
+    }
+}
+
+// Disegno delle rette, separato dal rilevamento
+void drawLines(Mat &img, const vector<HoughLine> &lines) {
+    int dist = cvCeil(hypot(img.rows, img.cols));
+    for (const HoughLine &l : lines) {
+        double sin_t = sin(l.theta), cos_t = cos(l.theta);
+        // Calcola i valori di x e di y del punto
+        double x = l.rho * cos_t;
+        double y = l.rho * sin_t;
+
+        // Calcoliamo i due estremi della retta
+        Point pt1(cvRound(x + dist * (-sin_t)), cvRound(y + dist * (cos_t)));
+        Point pt2(cvRound(x - dist * (-sin_t)), cvRound(y - dist * (cos_t)));
+        line(img, pt1, pt2, Scalar(0), 2, 0);
+    }
+}
+
+/*
+    Se orientation non è vuota (angolo del gradiente in gradi per ogni
+    pixel) ogni punto di edge vota solo entro angleWindow gradi dalla
+    direzione del suo gradiente invece che per tutti i 180 theta.
+*/
+void houghLines(const Mat &edgeCanny, vector<HoughLine> &lines, int threshold, int maxLines = 0, double rhoRes = 1.0, double thetaRes = 1.0,
+                const Mat &orientation = Mat(), double angleWindow = 0.0) {
     /* 2. Creiamo lo spazio dei voti
         Lo spazio dei voti sarà matrice con tutti zeri e dovrà
         avere una dimensione tale da poter considerare tutte le
         possibili rette che passano per il piano immagine.
     */
-    // Calcolo della distanza massima tra due punti nell'immagine
-    int dist = hypot(src.rows, src.cols);
-    // Inizializzazione della matrice dei voti
-    Mat votes = Mat::zeros(dist * 2, 180, CV_8U);
+    HoughLineSpace space = makeLineSpace(edgeCanny.rows, edgeCanny.cols, rhoRes, thetaRes);
 
-    double rho, theta;
-    /* 3. Per ogni punto (x,y) di edge */
-    for (int x = 0; x < edgeCanny.rows; x++) {
-        for (int y = 0; y < edgeCanny.cols; y++) {
-            // Se il punto (x,y) è un punto di edge
-            if (edgeCanny.at<uchar>(x, y) == 255) {
-                /* 4. Per ogni angolo theta che varia tra 0 e 180 */
-                for (theta = 0; theta < 180; theta++) {
-                    /* 5. Calcola rho */
-                    // (theta - 90) poiché l'intervallo theta varia da -90 a 90
-                    // Le funzioni cos() e sin() vogliono l'argomento in radianti perciò 
-                    // bisogna moltiplicare per pi greco / 180
-                    rho = dist + y * cos((theta - 90) * CV_PI / 180) + x * sin((theta - 90) * CV_PI / 180);
-                    /* 6. Effettua la votazione */
-                    votes.at<uchar>(rho, theta)++;
+    /* 3. Coordinate dei punti di edge */
+    vector<Point> points;
+    collectEdgePoints(edgeCanny, points);
+
+    /* 4-6. Per ogni theta e per ogni punto di edge calcola rho e vota */
+    Mat votes;
+    if (orientation.empty()) {
+        voteLines(points, space, votes);
+    }
+    else {
+        voteLinesOriented(points, orientation, space, cvCeil(angleWindow / thetaRes), votes);
+    }
+
+    /* 7. Andiamo a prendere i picchi (rho, theta) con almeno threshold voti */
+    findLinePeaks(votes, space, threshold, 1, maxLines, lines);
+}
+
+// Segmento individuato dalla versione probabilistica: estremi nell'immagine
+struct LineSegment {
+    Point p1, p2;
+};
+
+/*
+    Hough probabilistica progressiva. I punti di edge votano uno alla volta
+    in ordine casuale; appena il theta più votato del punto corrente supera
+    threshold si segue la retta (rho, theta) nella maschera degli edge a
+    partire dal punto, nei due versi, tollerando buchi fino a maxGap pixel.
+    I punti del segmento trovato escono dalla maschera e, se avevano già
+    votato, i loro voti vengono tolti dall'accumulatore: così ogni retta
+    viene trovata una volta sola e, sulle scene con poche rette, la maggior
+    parte dei punti non vota mai. Si tengono i segmenti lunghi almeno minLength.
+*/
+void houghLinesP(const Mat &edgeCanny, vector<LineSegment> &segments, int threshold, int minLength, int maxGap, double rhoRes = 1.0, double thetaRes = 1.0) {
+    // Stato dei pixel nella maschera: 255 = edge non ancora votato
+    const uchar VOTED = 128, FREE = 0;
+    HoughLineSpace space = makeLineSpace(edgeCanny.rows, edgeCanny.cols, rhoRes, thetaRes);
+    int64 bias = space.bias;
+    Mat votes = Mat::zeros(space.nTheta, space.nRho, CV_32S);
+    Mat mask = edgeCanny.clone();
+    segments.clear();
+
+    vector<Point> points;
+    collectEdgePoints(edgeCanny, points);
+    RNG rng;
+    for (int i = (int)points.size() - 1; i > 0; i--) {
+        swap(points[i], points[rng.uniform(0, i + 1)]);
+    }
+
+    // Aggiunge (+1) o toglie (-1) i voti del punto p, restituisce il theta più votato
+    auto vote = [&](Point p, int delta, int &bestVotes) {
+        int bestT = 0;
+        bestVotes = 0;
+        for (int t = 0; t < space.nTheta; t++) {
+            int &cell = votes.ptr<int>(t)[((int64)p.x * space.cosQ[t] + (int64)p.y * space.sinQ[t] + bias) >> space.shift];
+            cell += delta;
+            if (cell > bestVotes) {
+                bestVotes = cell;
+                bestT = t;
+            }
+        }
+        return bestT;
+    };
+
+    const int shift = 16;
+    for (const Point &p : points) {
+        // Il punto appartiene già a un segmento trovato
+        if (mask.at<uchar>(p) == FREE) continue;
+
+        int bestVotes;
+        int t = vote(p, 1, bestVotes);
+        mask.at<uchar>(p) = VOTED;
+        if (bestVotes < threshold) continue;
+
+        /* Direzione della retta, perpendicolare alla normale (cos, sin):
+           si avanza di un pixel lungo l'asse dominante e di una frazione
+           in virgola fissa lungo l'altro */
+        double a = -sin(space.theta[t]), b = cos(space.theta[t]);
+        bool xMajor = fabs(a) > fabs(b);
+        // Coordinate in virgola fissa a 64 bit: con shift = 16 un int trabocca già da 32768 pixel
+        int64 x0 = p.x, y0 = p.y, dx0, dy0;
+        if (xMajor) {
+            dx0 = a > 0 ? 1 : -1;
+            dy0 = cvRound(b * (1 << shift) / fabs(a));
+            y0 = (y0 << shift) + ((int64)1 << (shift - 1));
+        }
+        else {
+            dy0 = b > 0 ? 1 : -1;
+            dx0 = cvRound(a * (1 << shift) / fabs(b));
+            x0 = (x0 << shift) + ((int64)1 << (shift - 1));
+        }
+        auto pixelAt = [&](int64 x, int64 y) { return xMajor ? Point((int)x, (int)(y >> shift)) : Point((int)(x >> shift), (int)y); };
+
+        // Estremi del segmento nei due versi
+        Point ends[2] = {p, p};
+        for (int k = 0; k < 2; k++) {
+            int64 dx = k ? -dx0 : dx0, dy = k ? -dy0 : dy0;
+            int gap = 0;
+            for (int64 x = x0, y = y0;; x += dx, y += dy) {
+                Point q = pixelAt(x, y);
+                if (q.x < 0 || q.x >= mask.cols || q.y < 0 || q.y >= mask.rows) break;
+                if (mask.at<uchar>(q) != FREE) {
+                    gap = 0;
+                    ends[k] = q;
+                }
+                else if (++gap > maxGap) {
+                    break;
                 }
             }
         }
-    }
-    out = src.clone();
-    /* 7. Andiamo a prendere i valori (rho, theta) maggiori di una certa soglia */
-    for (int r = 0; r < votes.rows; r++) {
-        for (int t = 0; t < votes.cols; t++) {
-            // Se la retta caratterizzata dai parametri (rho, theta) è stata votata 
-            // da un numero di pixel maggiore della soglia
-            if (votes.at<uchar>(r, t) >= threshold) {
-                theta = (t - 90) * CV_PI / 180;
-                double sin_t = sin(theta), cos_t = cos(theta);
-                // Calcola i valori di x e di y del punto
-                int x = (r - dist) * cos_t;
-                int y = (r - dist) * sin_t;
-                
-                // Calcoliamo i due estremi della retta
-                Point pt1(cvRound(x + dist * (-sin_t)), cvRound(y + dist * (cos_t)));
-                Point pt2(cvRound(x - dist * (-sin_t)), cvRound(y - dist * (cos_t))); 
-                line(out, pt1, pt2, Scalar(0), 2, 0);
+        bool goodLine = abs(ends[1].x - ends[0].x) >= minLength || abs(ends[1].y - ends[0].y) >= minLength;
+
+        // I punti del segmento escono dalla maschera; se il segmento è buono si tolgono i loro voti
+        for (int k = 0; k < 2; k++) {
+            int64 dx = k ? -dx0 : dx0, dy = k ? -dy0 : dy0;
+            for (int64 x = x0, y = y0;; x += dx, y += dy) {
+                Point q = pixelAt(x, y);
+                uchar &m = mask.at<uchar>(q);
+                if (m != FREE) {
+                    if (goodLine && m == VOTED) {
+                        int unused;
+                        vote(q, -1, unused);
+                    }
+                    m = FREE;
+                }
+                if (q.x == ends[k].x && q.y == ends[k].y) break;
             }
         }
+
+        if (goodLine) {
+            segments.push_back({ends[0], ends[1]});
+        }
+    }
+}
+
+// Disegno dei segmenti
+void drawSegments(Mat &img, const vector<LineSegment> &segments) {
+    for (const LineSegment &s : segments) {
+        line(img, s.p1, s.p2, Scalar(0), 2, 0);
     }
 }
 
 int main(int argc, char **argv) {
+    // Modalità probabilistica: segmenti con estremi invece di rette infinite
+    const char *program = argv[0];
+    bool probabilistic = argc >= 2 && String(argv[1]) == "-p";
+    if (probabilistic) {
+        argv++;
+        argc--;
+    }
+
     // Controllo argomenti riga di comando
-    if (argc != 2) {
-        cout << "Usage: " << argv[0] << " image_name" << endl;
+    if (argc < 2 || (!probabilistic && (argc > 7 || argc == 5)) || (probabilistic && argc != 2 && argc != 5)) {
+        cout << "Usage: " << program << " image_name [threshold [maxLines [rhoRes thetaRes [angleWindow]]]]" << endl;
+        cout << "       " << program << " -p image_name [threshold minLength maxGap]" << endl;
         return -1;
     }
 
@@ -71,7 +433,19 @@ int main(int argc, char **argv) {
         return -1;
     }
 
-    int threshold = 150;
+    int threshold = (argc >= 3) ? stoi(argv[2]) : 150;
+    // Numero massimo di rette (0 = tutte quelle sopra la soglia)
+    int maxLines = (argc >= 4 && !probabilistic) ? stoi(argv[3]) : 0;
+    // Risoluzione dello spazio dei voti: pixel per rho e gradi per theta
+    double rhoRes = 1.0, thetaRes = 1.0;
+    if (argc >= 6 && !probabilistic) {
+        rhoRes = stod(argv[4]);
+        thetaRes = stod(argv[5]);
+        if (rhoRes <= 0 || thetaRes <= 0) {
+            cout << "rhoRes and thetaRes must be positive" << endl;
+            return -1;
+        }
+    }
 
     // Blurring dell'immagine per attenuare l'eventuale rumore
     GaussianBlur(src, src, Size(5, 5), 0, 0);
@@ -82,8 +456,39 @@ int main(int argc, char **argv) {
     imshow("Canny", edgeCanny);
     waitKey(0);
 
-    Mat out;
-    houghLines(src, out, edgeCanny, threshold);
+    Mat out = src.clone();
+    if (probabilistic) {
+        int minLength = (argc == 5) ? stoi(argv[3]) : 50;
+        int maxGap = (argc == 5) ? stoi(argv[4]) : 5;
+        vector<LineSegment> segments;
+        houghLinesP(edgeCanny, segments, threshold, minLength, maxGap);
+        for (const LineSegment &seg : segments) {
+            cout << "segment: (" << seg.p1.x << ", " << seg.p1.y << ") - (" << seg.p2.x << ", " << seg.p2.y << ")" << endl;
+        }
+        drawSegments(out, segments);
+        imshow("output", out);
+        waitKey(0);
+        return 0;
+    }
+
+    // Con angleWindow i punti votano solo attorno alla direzione del gradiente,
+    // calcolato con lo stesso Sobel 3x3 usato da Canny
+    Mat orientation;
+    double angleWindow = (argc == 7) ? stod(argv[6]) : 0.0;
+    if (angleWindow > 0) {
+        Mat dx, dy;
+        Sobel(src, dx, CV_32F, 1, 0, 3);
+        Sobel(src, dy, CV_32F, 0, 1, 3);
+        phase(dx, dy, orientation, true);
+    }
+
+    vector<HoughLine> lines;
+    houghLines(edgeCanny, lines, threshold, maxLines, rhoRes, thetaRes, orientation, angleWindow);
+    for (const HoughLine &l : lines) {
+        cout << "rho: " << l.rho << " theta: " << l.theta * 180 / CV_PI << " votes: " << l.votes << endl;
+    }
+
+    drawLines(out, lines);
 
     imshow("output", out);
     waitKey(0);
@@ -10,9 +10,14 @@
 */
 
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
-#include <vector>  
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 using namespace cv;
@@ -27,15 +32,127 @@ double euclideanDistance(Scalar p1, Scalar p2) {
     return distance;
 }
 
-void myKmeans(Mat &src, Mat &dst, int nClusters, double threshold) {
+// Immagine BGR a 8 bit convertita una volta in tre piani float (B, G, R)
+void toPlanarFloat(const Mat &src, vector<Mat> &planes) {
+    planes.assign(3, Mat());
+    for (int c = 0; c < 3; c++) {
+        planes[c].create(src.size(), CV_32F);
+    }
+    for (int x = 0; x < src.rows; x++) {
+        const Vec3b *srcRow = src.ptr<Vec3b>(x);
+        float *b = planes[0].ptr<float>(x), *g = planes[1].ptr<float>(x), *r = planes[2].ptr<float>(x);
+        for (int y = 0; y < src.cols; y++) {
+            b[y] = srcRow[y][0];
+            g[y] = srcRow[y][1];
+            r[y] = srcRow[y][2];
+        }
+    }
+}
+
+/*
+    Cluster più vicino di ogni pixel di una riga. Per trovare il minimo
+    basta la distanza al quadrato, senza radice, in float; con i piani
+    separati la distanza di 8 pixel da un centro si calcola con AVX2 in
+    poche istruzioni e il cluster migliore si aggiorna con una maschera.
+    A parità di distanza resta il cluster con indice minore.
+*/
+static void assignRow(const float *b, const float *g, const float *r, const float *cb, const float *cg, const float *cr, int nClusters, int *labels, int cols) {
+    int y = 0;
+#ifdef __AVX2__
+    for (; y + 8 <= cols; y += 8) {
+        __m256 vb = _mm256_loadu_ps(b + y), vg = _mm256_loadu_ps(g + y), vr = _mm256_loadu_ps(r + y);
+        __m256 best = _mm256_set1_ps(INFINITY);
+        __m256 bestK = _mm256_castsi256_ps(_mm256_setzero_si256());
+        for (int k = 0; k < nClusters; k++) {
+            __m256 db = _mm256_sub_ps(vb, _mm256_set1_ps(cb[k]));
+            __m256 dg = _mm256_sub_ps(vg, _mm256_set1_ps(cg[k]));
+            __m256 dr = _mm256_sub_ps(vr, _mm256_set1_ps(cr[k]));
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(db, db), _mm256_mul_ps(dg, dg)), _mm256_mul_ps(dr, dr));
+            __m256 closer = _mm256_cmp_ps(d, best, _CMP_LT_OQ);
+            best = _mm256_blendv_ps(best, d, closer);
+            bestK = _mm256_blendv_ps(bestK, _mm256_castsi256_ps(_mm256_set1_epi32(k)), closer);
+        }
+        _mm256_storeu_si256((__m256i *)(labels + y), _mm256_castps_si256(bestK));
+    }
+#endif
+    for (; y < cols; y++) {
+        float best = INFINITY;
+        int bestK = 0;
+        for (int k = 0; k < nClusters; k++) {
+            float db = b[y] - cb[k], dg = g[y] - cg[k], dr = r[y] - cr[k];
+            float d = db * db + dg * dg + dr * dr;
+            if (d < best) {
+                best = d;
+                bestK = k;
+            }
+        }
+        labels[y] = bestK;
+    }
+}
+
+/*
+    Assegnazione dei pixel ai cluster e accumulo delle somme in un'unica
+    passata sequenziale sull'immagine: l'etichetta del cluster più vicino
+    va nel piano labels (T = uchar fino a 256 cluster, ushort oltre) e il
+    colore del pixel si somma subito a quelli del suo cluster, senza
+    liste di punti da costruire, copiare e rileggere.
+*/
+template<typename T>
+void assignClusters(const Mat &src, const vector<Mat> &planes, const vector<Scalar> &centersColors, Mat &labels, vector<uint64_t> &sums, vector<uint64_t> &counts) {
+    int nClusters = (int)centersColors.size();
+    fill(sums.begin(), sums.end(), 0);
+    fill(counts.begin(), counts.end(), 0);
+
+    // Centri in float, una componente per vettore
+    vector<float> cb(nClusters), cg(nClusters), cr(nClusters);
+    for (int k = 0; k < nClusters; k++) {
+        cb[k] = (float)centersColors[k][0];
+        cg[k] = (float)centersColors[k][1];
+        cr[k] = (float)centersColors[k][2];
+    }
+
+    vector<int> rowLabels(src.cols);
+    for (int x = 0; x < src.rows; x++) {
+        assignRow(planes[0].ptr<float>(x), planes[1].ptr<float>(x), planes[2].ptr<float>(x),
+                  cb.data(), cg.data(), cr.data(), nClusters, rowLabels.data(), src.cols);
+
+        const Vec3b *srcRow = src.ptr<Vec3b>(x);
+        T *labelRow = labels.ptr<T>(x);
+        for (int y = 0; y < src.cols; y++) {
+            int clusterIndex = rowLabels[y];
+            labelRow[y] = (T)clusterIndex;
+            sums[3 * clusterIndex] += srcRow[y][0];
+            sums[3 * clusterIndex + 1] += srcRow[y][1];
+            sums[3 * clusterIndex + 2] += srcRow[y][2];
+            counts[clusterIndex]++;
+        }
+    }
+}
+
+// Ogni pixel prende il colore del centro del suo cluster, in una sola passata sulle etichette
+template<typename T>
+void recolorClusters(const Mat &labels, const vector<Scalar> &centersColors, Mat &dst) {
+    vector<Vec3b> colors(centersColors.size());
+    for (size_t k = 0; k < centersColors.size(); k++) {
+        for (int c = 0; c < 3; c++) {
+            colors[k][c] = saturate_cast<uchar>(centersColors[k][c]);
+        }
+    }
+    for (int x = 0; x < labels.rows; x++) {
+        const T *labelRow = labels.ptr<T>(x);
+        Vec3b *dstRow = dst.ptr<Vec3b>(x);
+        for (int y = 0; y < labels.cols; y++) {
+            dstRow[y] = colors[labelRow[y]];
+        }
+    }
+}
+
+// Centri iniziali: i colori di nClusters pixel scelti a caso
+vector<Scalar> initCenters(const Mat &src, int nClusters) {
     // Vettore che contiene i colori dei centri
     vector<Scalar> centersColors;
-    // Vettore che contiene i punti dei cluster
-    vector<vector<Point>> clusters;
-
     RNG random(getTickCount());
 
-    /* 1. Inizializzo i centri del cluster in maniera random */
     for (int k = 0; k < nClusters; k++) {
         // Calcolo delle coordinate del centro
         Point center;
@@ -46,116 +163,192 @@ void myKmeans(Mat &src, Mat &dst, int nClusters, double threshold) {
         Scalar center_color(src.at<Vec3b>(center)[0], src.at<Vec3b>(center)[1], src.at<Vec3b>(center)[2]);
         // Aggiungo il colore del centro al vettore che contiene i colori dei centri
         centersColors.push_back(center_color);
+    }
+    return centersColors;
+}
 
-        // Vettore che conterrà i pixel assegnati ad ogni cluster
-        vector<Point> pointInClusterK;
-        // Aggiungo un vettore di punti al vettore che conterrà i punti del cluster
-        clusters.push_back(pointInClusterK);
+/*
+    Aggiornamento dei centri, ovvero ricalcolo delle medie dalle somme dei
+    colori e dal numero di pixel di ogni cluster. Restituisce la media
+    degli spostamenti dei centri.
+*/
+double updateCenters(const vector<uint64_t> &sums, const vector<uint64_t> &counts, vector<Scalar> &centersColors) {
+    int nClusters = (int)centersColors.size();
+    double newCenterSum = 0;
+
+    for (int k = 0; k < nClusters; k++) {
+        // Un cluster rimasto vuoto tiene il suo centro
+        if (counts[k] == 0) continue;
+
+        // Calcolo della medie dei colori del nuovo centro
+        Scalar newCenter((double)sums[3 * k] / counts[k], (double)sums[3 * k + 1] / counts[k], (double)sums[3 * k + 2] / counts[k]);
+
+        // Calcolo distanza tra vecchio e nuovo centro
+        newCenterSum += euclideanDistance(newCenter, centersColors[k]);
+        // Aggiornamento nuovo centro
+        centersColors[k] = newCenter;
     }
 
+    // Calcolo della media dividendo la media per il numero di cluster
+    return newCenterSum / nClusters;
+}
+
+void myKmeans(Mat &src, Mat &dst, int nClusters, double threshold) {
+    // Piano delle etichette: per ogni pixel l'indice del suo cluster
+    Mat labels(src.size(), nClusters <= 256 ? CV_8U : CV_16U);
+    // Somme dei colori (B, G, R) e numero di pixel di ogni cluster
+    vector<uint64_t> sums(3 * nClusters), counts(nClusters);
+    // Piani float dell'immagine per il calcolo delle distanze
+    vector<Mat> planes;
+    toPlanarFloat(src, planes);
+
+    /* 1. Inizializzo i centri del cluster in maniera random */
+    vector<Scalar> centersColors = initCenters(src, nClusters);
+
     //* 2. Assegno i pixel ai cluster, ricalcolo i centri usando le medie, fino a che la differenza > 0.1 */
     double oldCenterSum = 0.0;
     double diffOldNewAvg = INFINITY; // Differenza tra la vecchia e la nuova media
 
     // Itera finché la differenza tra le vecchie medie e le nuove supera una certa soglia
     while (diffOldNewAvg > threshold) {
-        // Pulizia dei vettori di punti presenti nei cluster
-        for (int k = 0; k < nClusters; k++) {
-            clusters[k].clear();
+        // Assegno i pixel ai cluster accumulando le somme dei colori
+        if (labels.depth() == CV_8U) {
+            assignClusters<uchar>(src, planes, centersColors, labels, sums, counts);
+        }
+        else {
+            assignClusters<ushort>(src, planes, centersColors, labels, sums, counts);
         }
 
-        // Assegno i pixel ai cluster
-        for (int x = 0; x < src.rows; x++) {
-            for (int y = 0; y < src.cols; y++) {
-                // Calcolo le distanze da ogni centro dei cluster e posiziono il pixel nel cluster più vicino.
-                double minDistance = INFINITY;
-                int clusterIndex = 0; // Serve per memorizzare quale cluster è più vicino al pixel
-
-                // Estrazione del pixel in posizione x, y
-                Scalar point = src.at<Vec3b>(x, y);
-
-                // Ciclo su ogni cluster per capire il pixel a quale
-                // cluster deve essere assegnato
-                for (int k = 0; k < nClusters; k++) {
-                    // Estrazione del centro del cluster (vettore di 3 componenti RGB)
-                    Scalar center = centersColors[k];
+        double newCenterSum = updateCenters(sums, counts, centersColors);
+        // Calcolo della differenza tra la vecchia somma e la nuova somma
+        diffOldNewAvg = abs(oldCenterSum - newCenterSum);
+        // Aggiornamento della somma
+        oldCenterSum = newCenterSum;
+    }
 
-                    // Calcolo della distanza Euclidea tra il centro del cluster e il pixel x,y
-                    double distance = euclideanDistance(point, center);
+    // Nell'immagine di output, bisogna assegnare ad ogni pixel nel cluster
+    // k il livello di intensità del centro del cluster
+    if (labels.depth() == CV_8U) {
+        recolorClusters<uchar>(labels, centersColors, dst);
+    }
+    else {
+        recolorClusters<ushort>(labels, centersColors, dst);
+    }
+}
 
-                    // Se la distanza è la minore, la si aggiorna
-                    if (distance < minDistance) {
-                        minDistance = distance;
-                        clusterIndex = k;
-                    }
-                }
+// Indice del bin dell'istogramma 3D di un colore, con bits bit per canale
+static inline int colorBin(const Vec3b &p, int bits) {
+    int shift = 8 - bits;
+    return ((p[0] >> shift) << (2 * bits)) | ((p[1] >> shift) << bits) | (p[2] >> shift);
+}
 
-                // Aggiunta del pixel nel vettore k dei cluster
-                clusters[clusterIndex].push_back(Point(y, x));
+/*
+    K-means sui colori invece che sui pixel: l'immagine viene ridotta a un
+    istogramma 3D dei colori con bits bit per canale (8 = colori esatti) e
+    il k-means pesato gira sui soli bin occupati, che in una foto sono
+    molti meno dei pixel. Ogni bin partecipa con il colore medio dei suoi
+    pixel e pesa quanto il numero di pixel, quindi le medie dei cluster
+    sono le stesse che si avrebbero sui pixel del bin; alla fine ogni bin
+    ha il colore del suo cluster e i pixel si ricolorano con questa tabella.
+*/
+void histogramKmeans(const Mat &src, Mat &dst, int nClusters, double threshold, int bits = 6) {
+    int nBins = 1 << (3 * bits);
+    // Numero di pixel e, se i bin non sono esatti, somma dei colori (B, G, R) di ogni bin
+    vector<uint32_t> binCounts(nBins, 0);
+    vector<uint64_t> binSums(bits < 8 ? 3 * nBins : 0, 0);
+    for (int x = 0; x < src.rows; x++) {
+        const Vec3b *srcRow = src.ptr<Vec3b>(x);
+        for (int y = 0; y < src.cols; y++) {
+            int bin = colorBin(srcRow[y], bits);
+            binCounts[bin]++;
+            if (bits < 8) {
+                binSums[3 * bin] += srcRow[y][0];
+                binSums[3 * bin + 1] += srcRow[y][1];
+                binSums[3 * bin + 2] += srcRow[y][2];
             }
         }
+    }
 
-        // Aggiornamento dei centri, ovvero ricalcolo delle medie
-        double newCenterSum = 0;
+    // Bin occupati: colore medio in piani float, somme dei colori e peso
+    vector<int> occupied;
+    vector<float> binB, binG, binR;
+    vector<uint64_t> occupiedSums;
+    for (int bin = 0; bin < nBins; bin++) {
+        uint32_t n = binCounts[bin];
+        if (n == 0) continue;
+        uint64_t sb, sg, sr;
+        if (bits < 8) {
+            sb = binSums[3 * bin];
+            sg = binSums[3 * bin + 1];
+            sr = binSums[3 * bin + 2];
+        }
+        else {
+            sb = (uint64_t)(bin >> 16) * n;
+            sg = (uint64_t)((bin >> 8) & 255) * n;
+            sr = (uint64_t)(bin & 255) * n;
+        }
+        occupied.push_back(bin);
+        binB.push_back((float)sb / n);
+        binG.push_back((float)sg / n);
+        binR.push_back((float)sr / n);
+        occupiedSums.insert(occupiedSums.end(), {sb, sg, sr});
+    }
+    int nOccupied = (int)occupied.size();
 
-        for (int k = 0; k < nClusters; k++) {
-            // Estrazione di tutti i pixel presenti nel cluster k
-            vector<Point> clusterKPoints = clusters[k];
-            double blue = 0.0, green = 0.0, red = 0.0;
-
-            // Somma dei colori di tutti i punti del cluster k
-            for (int i = 0; i < clusterKPoints.size(); i++) {
-                Point pixel = clusterKPoints[i];
-                blue += src.at<Vec3b>(pixel)[0];
-                green += src.at<Vec3b>(pixel)[1];
-                red += src.at<Vec3b>(pixel)[2];
-            }
+    vector<uint64_t> sums(3 * nClusters), counts(nClusters);
+    vector<int> binLabels(nOccupied);
+    vector<float> cb(nClusters), cg(nClusters), cr(nClusters);
 
-            // Calcolo della medie dei colori del nuovo centro
-            blue /= clusterKPoints.size();
-            green /= clusterKPoints.size();
-            red /= clusterKPoints.size();
+    /* 1. Inizializzo i centri del cluster in maniera random */
+    vector<Scalar> centersColors = initCenters(src, nClusters);
 
-            // Estrazione del vecchio centro
-            Scalar center = centersColors[k];
-            // Calcolo del nuovo centro
-            Scalar newCenter(blue, green, red);
+    /* 2. Assegno i bin ai cluster, ricalcolo i centri usando le medie pesate */
+    double oldCenterSum = 0.0;
+    double diffOldNewAvg = INFINITY;
+    while (diffOldNewAvg > threshold) {
+        for (int k = 0; k < nClusters; k++) {
+            cb[k] = (float)centersColors[k][0];
+            cg[k] = (float)centersColors[k][1];
+            cr[k] = (float)centersColors[k][2];
+        }
+        assignRow(binB.data(), binG.data(), binR.data(), cb.data(), cg.data(), cr.data(), nClusters, binLabels.data(), nOccupied);
 
-            // Calcolo distanza tra vecchio e nuovo centro
-            newCenterSum += euclideanDistance(newCenter, center);
-            // Aggiornamento nuovo centro
-            centersColors[k] = newCenter;
+        fill(sums.begin(), sums.end(), 0);
+        fill(counts.begin(), counts.end(), 0);
+        for (int i = 0; i < nOccupied; i++) {
+            int k = binLabels[i];
+            sums[3 * k] += occupiedSums[3 * i];
+            sums[3 * k + 1] += occupiedSums[3 * i + 1];
+            sums[3 * k + 2] += occupiedSums[3 * i + 2];
+            counts[k] += binCounts[occupied[i]];
         }
 
-        // Calcolo della media dividendo la media per il numero di cluster
-        newCenterSum /= nClusters;
-        // Calcolo della differenza tra la vecchia somma e la nuova somma
+        double newCenterSum = updateCenters(sums, counts, centersColors);
         diffOldNewAvg = abs(oldCenterSum - newCenterSum);
-        // Aggiornamento della somma
         oldCenterSum = newCenterSum;
     }
 
-    // Nell'immagine di output, bisogna assegnare ad ogni pixel nel cluster
-    // k il livello di intensità del centro del cluster
-    for (int k = 0; k < nClusters; k++) {
-        // Estrazione di tutti i punti del cluster
-        vector<Point> clusterPoints = clusters[k];
-        // Estrazione del centro del cluster
-        Scalar center = centersColors[k];
-        for (int i = 0; i < clusterPoints.size(); i++) {
-            // Ad ogni pixel viene assegnata l'intensità del centro del cluster
-            Point pixel = clusterPoints[i];
-            dst.at<Vec3b>(pixel)[0] = center[0];
-            dst.at<Vec3b>(pixel)[1] = center[1];
-            dst.at<Vec3b>(pixel)[2] = center[2];
+    // Tabella bin -> colore del centro del suo cluster, poi una passata sui pixel
+    vector<Vec3b> binColors(nBins);
+    for (int i = 0; i < nOccupied; i++) {
+        const Scalar &center = centersColors[binLabels[i]];
+        for (int c = 0; c < 3; c++) {
+            binColors[occupied[i]][c] = saturate_cast<uchar>(center[c]);
+        }
+    }
+    for (int x = 0; x < src.rows; x++) {
+        const Vec3b *srcRow = src.ptr<Vec3b>(x);
+        Vec3b *dstRow = dst.ptr<Vec3b>(x);
+        for (int y = 0; y < src.cols; y++) {
+            dstRow[y] = binColors[colorBin(srcRow[y], bits)];
         }
     }
 }
 
 int main(int argc, char **argv) {
     // Controllo argomenti riga di comando
-    if (argc != 3) {
-        cout << "Usage: " << argv[0] << " image_name number_of_clusters" << endl;
+    if (argc != 3 && argc != 4) {
+        cout << "Usage: " << argv[0] << " image_name number_of_clusters [bits_per_channel]" << endl;
         return -1;
     }
 
@@ -168,9 +361,25 @@ int main(int argc, char **argv) {
 
     // Il numero di cluster è passato da riga di comando come secondo argomento
     int clusters_number = stoi(argv[2]);
+    // Le etichette sono a 16 bit
+    if (clusters_number < 1 || clusters_number > 65536) {
+        cout << "The number of clusters must be between 1 and 65536" << endl;
+        return -1;
+    }
 
     Mat dst(src.size(), src.type());
-    myKmeans(src, dst, clusters_number, 0.1);
+    if (argc == 4) {
+        // Con i bit per canale si raggruppano i colori dell'istogramma invece dei pixel
+        int bits = stoi(argv[3]);
+        if (bits < 1 || bits > 8) {
+            cout << "The bits per channel must be between 1 and 8" << endl;
+            return -1;
+        }
+        histogramKmeans(src, dst, clusters_number, 0.1, bits);
+    }
+    else {
+        myKmeans(src, dst, clusters_number, 0.1);
+    }
     
     imshow("Source image", src);
 	imshow("K-Means", dst);
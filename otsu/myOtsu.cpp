@@ -1,15 +1,18 @@
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <vector>
 
 using namespace std;
 using namespace cv;
 
-int Otsu(vector<double> his) {
+int Otsu(const vector<double> &his) {
+    int L = his.size();
     double mediaCumGlob = 0.0f;
     // Calcolo della media cumulativa globale mG
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < L; i++) {
         mediaCumGlob += i * his[i];
     }
     
@@ -17,8 +20,8 @@ int Otsu(vector<double> his) {
     double currMediaCum = 0.0f;
     double currVar = 0.0f;
     double maxVar = 0.0f;
-    int thresh;
-    for (int i = 0; i < 256; i++) {
+    int thresh = 0;
+    for (int i = 0; i < L; i++) {
         // Calcolo somma cumulativa P1(k)
         prob += his[i];
         // Calcolo media cumulativa m(k)
@@ -35,97 +38,416 @@ int Otsu(vector<double> his) {
     return thresh;
 }
 
-vector<double> NormalizedHistogram(Mat img) {
-    // Inizializziamo il vettore di double
-    vector<double> his(256, 0.0f);
-
-    // Calcoliamo il numero di occorrenze in termini
-    // di valore di intensità per ogni pixel
-    for (int y = 0; y < img.rows; y++) {
-        for (int x = 0; x < img.cols; x++) {
-            his[img.at<uchar>(y, x)]++;
+/*
+    Accumula l'istogramma intero delle righe [y0, y1) in bins.
+    Con lanes > 1 i pixel consecutivi incrementano copie diverse
+    dell'istogramma (bins[lane * nBins + v]): su zone uniformi due
+    incrementi di fila dello stesso contatore dovrebbero altrimenti
+    aspettare l'uno la scrittura dell'altro.
+*/
+template <typename T>
+static void AccumulateHistogram(const Mat &img, int y0, int y1, int nBins, int lanes, vector<uint32_t> &bins) {
+    for (int y = y0; y < y1; y++) {
+        const T *row = img.ptr<T>(y);
+        int x = 0;
+        if (lanes == 4) {
+            uint32_t *b0 = bins.data(), *b1 = b0 + nBins, *b2 = b1 + nBins, *b3 = b2 + nBins;
+            for (; x + 4 <= img.cols; x += 4) {
+                b0[row[x]]++;
+                b1[row[x + 1]]++;
+                b2[row[x + 2]]++;
+                b3[row[x + 3]]++;
+            }
+        }
+        for (; x < img.cols; x++) {
+            bins[row[x]]++;
         }
     }
+}
 
-    // Normalizzazione dell'istogramma
-    for (int i = 0; i < 256; i++) {
-        his[i] /= img.rows *img.cols;
+/*
+    Istogramma (conteggi) di un'immagine a 8 bit (256 livelli) o a 16 bit
+    (65536 livelli). Ogni striscia di righe conta in parallelo su un
+    istogramma privato di interi; le copie si sommano una sola volta alla fine.
+*/
+vector<uint64_t> HistogramCounts(const Mat &img) {
+    CV_Assert(img.type() == CV_8UC1 || img.type() == CV_16UC1);
+    bool is8bit = img.depth() == CV_8U;
+    int nBins = is8bit ? 256 : 65536;
+    // Con 16 bit quattro copie per striscia occuperebbero troppa cache
+    int lanes = is8bit ? 4 : 1;
+
+    int nStrips = max(1, min(img.rows, getNumThreads()));
+    vector<vector<uint32_t>> partial(nStrips);
+    parallel_for_(Range(0, nStrips), [&](const Range &range) {
+        for (int s = range.start; s < range.end; s++) {
+            partial[s].assign(nBins * lanes, 0);
+            int y0 = img.rows * s / nStrips, y1 = img.rows * (s + 1) / nStrips;
+            if (is8bit) {
+                AccumulateHistogram<uchar>(img, y0, y1, nBins, lanes, partial[s]);
+            }
+            else {
+                AccumulateHistogram<ushort>(img, y0, y1, nBins, lanes, partial[s]);
+            }
+        }
+    });
+
+    // Riduzione delle copie
+    vector<uint64_t> counts(nBins, 0);
+    for (const vector<uint32_t> &bins : partial) {
+        for (int l = 0; l < lanes; l++) {
+            for (int i = 0; i < nBins; i++) {
+                counts[i] += bins[l * nBins + i];
+            }
+        }
     }
 
+    return counts;
+}
+
+// Normalizzazione dei conteggi in un istogramma di probabilità
+vector<double> NormalizeCounts(const vector<uint64_t> &counts) {
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+        total += c;
+    }
+    vector<double> his(counts.size(), 0.0);
+    for (size_t i = 0; i < counts.size() && total > 0; i++) {
+        his[i] = (double)counts[i] / total;
+    }
     return his;
 }
 
-vector<int> OtsuMultipleThresh(vector<double> his) {
-    // Calcolo della media cumulativa globale mG
-    double mediaCumGlob = 0.0f;
-    for (int i = 0; i < 256; i++) {
-        mediaCumGlob += i * his[i];
+vector<double> NormalizedHistogram(const Mat &img) {
+    return NormalizeCounts(HistogramCounts(img));
+}
+
+/*
+    Tabelle dei momenti cumulativi dell'istogramma:
+    P[i] = somma di his[0..i-1] (momento di ordine zero)
+    S[i] = somma di k * his[k] per k in [0, i-1] (momento del primo ordine)
+    Con le tabelle la probabilità e la media cumulativa di un qualunque
+    intervallo di livelli [a, b) costano due sottrazioni.
+*/
+struct MomentTables {
+    vector<double> P, S;
+};
+
+MomentTables BuildMomentTables(const vector<double> &his) {
+    MomentTables t;
+    t.P.assign(his.size() + 1, 0.0);
+    t.S.assign(his.size() + 1, 0.0);
+    for (size_t i = 0; i < his.size(); i++) {
+        t.P[i + 1] = t.P[i] + his[i];
+        t.S[i + 1] = t.S[i] + i * his[i];
     }
+    return t;
+}
 
-    // Abbiamo 3 classi, quindi 3 probabilità e 3 medie cumulative
-    vector<double> prob(3, 0.0f);
-    vector<double> currMediaCum(3, 0.0f);
-    double currVar = 0.0f;
-    double maxVar = 0.0f;
-    // Abbiamo due soglie poiché abbiamo 3 classi
-    vector<int> thresh(2, 0);
-    for (int i = 0; i < 256 - 2; i++) {
-        // Calcolo somma cumulativa P1(k)
-        prob[0] += his[i];
-        // Calcolo media cumulativa m1(k)
-        currMediaCum[0] += i * his[i];
-
-        for (int j = i + 1; j < 256 - 1; j++) {
-            // Calcolo somma cumulativa P2(k)
-            prob[1] += his[j];
-            // Calcolo media cumulativa m2(k)
-            currMediaCum[1] += j * his[j];
-
-            for (int k = j + 1; k < 256; k++) {
-                // Calcolo somma cumulativa P3(k)
-                prob[2] += his[k];
-                // Calcolo media cumulativa m3(k)
-                currMediaCum[2] += k * his[k];
-
-                // Calcolo della varianza interclasse sigma(k1, k2)
-                currVar = 0.0f;
-                for (int w = 0; w < 3; w++) {
-                    currVar += prob[w] * pow(currMediaCum[w] / prob[w] - mediaCumGlob, 2);
-                }
+/*
+    Contributo della classe [a, b) alla varianza interclasse.
+    Poiché sigma^2 = somma_k P_k * (m_k - mG)^2 = somma_k S_k^2 / P_k - mG^2
+    e mG non dipende dalle soglie, basta massimizzare la somma di S_k^2 / P_k.
+    Una classe vuota non contribuisce.
+*/
+static inline double ClassScore(const MomentTables &t, int a, int b) {
+    double p = t.P[b] - t.P[a];
+    double s = t.S[b] - t.S[a];
+    return p > 0.0 ? s * s / p : 0.0;
+}
+
+/*
+    Otsu con un numero arbitrario di classi (nClasses - 1 soglie).
+    La funzione obiettivo è una somma di contributi indipendenti per classe,
+    quindi la soluzione ottima si trova con la programmazione dinamica:
+    best[c][j] è il massimo con c classi che coprono i livelli [0, j) e
+    best[c][j] = max_i best[c - 1][i] + ClassScore(i, j).
+    Il costo è O(nClasses * L^2) invece di O(L^(nClasses - 1)) della forza bruta.
+    Come per Otsu() la soglia k indica l'ultimo livello della classe k.
+*/
+vector<int> OtsuMultipleThresh(const vector<double> &his, int nClasses = 3) {
+    int L = his.size();
+    MomentTables t = BuildMomentTables(his);
 
-                // Calcolo della varianza massima
-                if (currVar > maxVar) {
-                    maxVar = currVar;
-                    thresh[0] = i;
-                    thresh[1] = j;
+    vector<vector<double>> best(nClasses + 1, vector<double>(L + 1, -INFINITY));
+    vector<vector<int>> arg(nClasses + 1, vector<int>(L + 1, 0));
+    for (int j = 1; j <= L; j++) {
+        best[1][j] = ClassScore(t, 0, j);
+    }
+    for (int c = 2; c <= nClasses; c++) {
+        // Ogni classe ha almeno un livello: le prime c - 1 classi occupano almeno c - 1 livelli
+        for (int j = c; j <= L; j++) {
+            for (int i = c - 1; i < j; i++) {
+                double v = best[c - 1][i] + ClassScore(t, i, j);
+                if (v > best[c][j]) {
+                    best[c][j] = v;
+                    arg[c][j] = i;
                 }
             }
-            prob[2] = currMediaCum[2] = 0.0f;
         }
-        prob[1] = currMediaCum[1] = 0.0f;
+    }
+
+    // Ricostruzione delle soglie a ritroso
+    vector<int> thresh(nClasses - 1);
+    int j = L;
+    for (int c = nClasses; c >= 2; c--) {
+        j = arg[c][j];
+        thresh[c - 2] = j - 1;
     }
 
     return thresh;
 }
 
-void MultipleThreshold(Mat img, Mat &out, vector<int> thresh) {
-    out = Mat::zeros(img.size(), img.type());
-    for (int y = 0; y < img.rows; y++) {
-        for (int x = 0; x < img.cols; x++) {
-            if (img.at<uchar>(y, x) >= thresh[1]) {
-                out.at<uchar>(y, x) = 255;
+/*
+    Tabella di 256 elementi che associa ad ogni livello di grigio il livello
+    di uscita della sua classe; i livelli delle classi sono distribuiti
+    uniformemente in [0, 255]. Un pixel passa alla classe successiva quando
+    supera la soglia. Le soglie devono essere in ordine crescente; senza
+    soglie c'è una sola classe e tutti i livelli vanno a 0.
+*/
+Mat ThresholdLUT(const vector<int> &thresh) {
+    int nClasses = thresh.size() + 1;
+    Mat lut(1, 256, CV_8U);
+    int c = 0;
+    for (int v = 0; v < 256; v++) {
+        while (c < (int)thresh.size() && v > thresh[c]) {
+            c++;
+        }
+        lut.at<uchar>(0, v) = (nClasses > 1) ? 255 * c / (nClasses - 1) : 0;
+    }
+    return lut;
+}
+
+/*
+    Applicazione delle soglie con una tabella di lookup: il costo per pixel
+    è lo stesso per qualunque numero di classi. LUT di OpenCV è vettorizzata
+    e parallela; se out ha già dimensione e tipo giusti (ad esempio un
+    buffer del chiamante) viene scritta direttamente senza riallocarla.
+*/
+void MultipleThreshold(const Mat &img, Mat &out, const vector<int> &thresh) {
+    out.create(img.size(), CV_8U);
+    LUT(img, ThresholdLUT(thresh), out);
+}
+
+/*
+    OTSU ADATTIVO A TILE
+    L'immagine è divisa in tile tileSize x tileSize. Dagli istogrammi dei
+    tile si costruisce un istogramma integrale sulla griglia dei tile:
+    II[ty][tx] è l'istogramma di tutti i tile con indici minori di (ty, tx),
+    quindi l'istogramma di un qualunque rettangolo di tile si ottiene con
+    quattro accessi per livello, indipendentemente dalla sua area.
+    La soglia di ogni tile è quella di Otsu sulla finestra di
+    (2 * radius + 1)^2 tile centrata su di esso; la soglia di ogni pixel
+    si interpola bilinearmente tra i centri dei quattro tile più vicini.
+*/
+void AdaptiveOtsu(const Mat &img, Mat &out, int tileSize, int radius) {
+    int tilesX = (img.cols + tileSize - 1) / tileSize, tilesY = (img.rows + tileSize - 1) / tileSize;
+    int gridCols = tilesX + 1;
+
+    /* 1. Istogrammi dei tile in parallelo, ogni tile ha il suo istogramma */
+    vector<uint32_t> II((size_t)(tilesY + 1) * gridCols * 256, 0);
+    auto cell = [&](int ty, int tx) { return II.data() + ((size_t)ty * gridCols + tx) * 256; };
+    parallel_for_(Range(0, tilesX * tilesY), [&](const Range &range) {
+        for (int t = range.start; t < range.end; t++) {
+            int tx = t % tilesX, ty = t / tilesX;
+            uint32_t *h = cell(ty + 1, tx + 1);
+            int x1 = min(img.cols, (tx + 1) * tileSize), y1 = min(img.rows, (ty + 1) * tileSize);
+            for (int y = ty * tileSize; y < y1; y++) {
+                const uchar *row = img.ptr<uchar>(y);
+                for (int x = tx * tileSize; x < x1; x++) {
+                    h[row[x]]++;
+                }
+            }
+        }
+    });
+
+    /* 2. Somme prefisse sulla griglia: prima lungo le righe, poi lungo le colonne */
+    for (int ty = 1; ty <= tilesY; ty++) {
+        for (int tx = 2; tx <= tilesX; tx++) {
+            uint32_t *h = cell(ty, tx), *left = cell(ty, tx - 1);
+            for (int b = 0; b < 256; b++) h[b] += left[b];
+        }
+    }
+    for (int ty = 2; ty <= tilesY; ty++) {
+        for (int tx = 1; tx <= tilesX; tx++) {
+            uint32_t *h = cell(ty, tx), *up = cell(ty - 1, tx);
+            for (int b = 0; b < 256; b++) h[b] += up[b];
+        }
+    }
+
+    /* 3. Soglia di Otsu di ogni tile sulla sua finestra di tile, in parallelo */
+    Mat thresh(tilesY, tilesX, CV_32F);
+    parallel_for_(Range(0, tilesX * tilesY), [&](const Range &range) {
+        vector<double> his(256);
+        for (int t = range.start; t < range.end; t++) {
+            int tx = t % tilesX, ty = t / tilesX;
+            int x0 = max(0, tx - radius), x1 = min(tilesX, tx + radius + 1);
+            int y0 = max(0, ty - radius), y1 = min(tilesY, ty + radius + 1);
+            const uint32_t *a = cell(y1, x1), *b = cell(y0, x1), *c = cell(y1, x0), *d = cell(y0, x0);
+            double total = 0.0;
+            for (int i = 0; i < 256; i++) {
+                his[i] = (double)a[i] - b[i] - c[i] + d[i];
+                total += his[i];
             }
-            else if (img.at<uchar>(y, x) >= thresh[0]) {
-                out.at<uchar>(y, x) = 127;
+            for (int i = 0; i < 256; i++) {
+                his[i] /= total;
             }
+            thresh.at<float>(ty, tx) = Otsu(his);
+        }
+    });
+
+    /* 4. Interpolazione bilineare delle soglie tra i centri dei tile */
+    out.create(img.rows, img.cols, CV_8U);
+    parallel_for_(Range(0, img.rows), [&](const Range &range) {
+        for (int y = range.start; y < range.end; y++) {
+            // Posizione rispetto ai centri dei tile, bloccata ai bordi
+            float fy = min(max((y + 0.5f) / tileSize - 0.5f, 0.0f), (float)(tilesY - 1));
+            int ty0 = (int)fy, ty1 = min(ty0 + 1, tilesY - 1);
+            float wy = fy - ty0;
+            const float *t0 = thresh.ptr<float>(ty0), *t1 = thresh.ptr<float>(ty1);
+            const uchar *row = img.ptr<uchar>(y);
+            uchar *o = out.ptr<uchar>(y);
+            for (int x = 0; x < img.cols; x++) {
+                float fx = min(max((x + 0.5f) / tileSize - 0.5f, 0.0f), (float)(tilesX - 1));
+                int tx0 = (int)fx, tx1 = min(tx0 + 1, tilesX - 1);
+                float wx = fx - tx0;
+                float t = (1 - wy) * ((1 - wx) * t0[tx0] + wx * t0[tx1]) + wy * ((1 - wx) * t1[tx0] + wx * t1[tx1]);
+                o[x] = row[x] > t ? 255 : 0;
+            }
+        }
+    });
+}
+
+/*
+    OTSU IN STREAMING SU VIDEO
+    Tra un frame e il successivo l'istogramma cambia poco, quindi:
+    - l'istogramma di ogni frame si calcola solo su una riga ogni rowStep;
+    - si tiene la somma degli istogrammi degli ultimi windowFrames frame,
+      aggiornata aggiungendo il frame nuovo e togliendo il più vecchio;
+    - la soglia è il massimo esatto su tutti i livelli; quella del frame
+      precedente serve solo a scegliere tra massimi di pari valore;
+    - la soglia applicata è smussata nel tempo con una media esponenziale
+      di peso alpha, per evitare sfarfallii tra frame consecutivi.
+*/
+struct StreamingOtsu {
+    int windowFrames = 8;
+    int rowStep = 4;
+    double alpha = 0.3;
+
+    deque<vector<uint64_t>> frames;
+    vector<uint64_t> counts = vector<uint64_t>(256, 0);
+    int lastThresh = -1;
+    double smoothed = 0.0;
+};
+
+// Varianza interclasse di Otsu per la soglia k, dalle tabelle dei momenti
+static inline double BetweenClassVariance(const MomentTables &t, int k) {
+    double p1 = t.P[k + 1], m = t.S[k + 1], mG = t.S.back();
+    if (p1 <= 0.0 || p1 >= 1.0) return 0.0;
+    double d = mG * p1 - m;
+    return d * d / (p1 * (1.0 - p1));
+}
+
+/*
+    Massimo della varianza interclasse su tutti i 256 livelli: cercarlo solo
+    vicino alla soglia precedente può fermarsi su un massimo locale con gli
+    istogrammi multimodali, e le 256 valutazioni costano poco rispetto
+    all'istogramma. A parità di varianza si sceglie la soglia più vicina a
+    prefer (la soglia del frame precedente, -1 se non c'è), così la soglia
+    non salta tra due massimi equivalenti.
+*/
+static int BestThreshold(const MomentTables &t, int prefer) {
+    int best = 0;
+    double maxVar = -1.0;
+    for (int k = 0; k <= 255; k++) {
+        double v = BetweenClassVariance(t, k);
+        if (v > maxVar || (v == maxVar && prefer >= 0 && abs(k - prefer) < abs(best - prefer))) {
+            maxVar = v;
+            best = k;
         }
     }
+    return best;
+}
+
+// Aggiorna lo stato con un frame a 8 bit e restituisce la soglia da applicare
+int StreamingOtsuUpdate(StreamingOtsu &state, const Mat &frame) {
+    /* 1. Istogramma delle sole righe campionate: un header con passo rowStep righe */
+    int sampledRows = (frame.rows + state.rowStep - 1) / state.rowStep;
+    Mat sampled(sampledRows, frame.cols, CV_8U, (void *)frame.data, frame.step * state.rowStep);
+    vector<uint64_t> frameCounts = HistogramCounts(sampled);
+
+    /* 2. Finestra scorrevole di frame */
+    for (int i = 0; i < 256; i++) {
+        state.counts[i] += frameCounts[i];
+    }
+    state.frames.push_back(frameCounts);
+    if ((int)state.frames.size() > state.windowFrames) {
+        const vector<uint64_t> &oldest = state.frames.front();
+        for (int i = 0; i < 256; i++) {
+            state.counts[i] -= oldest[i];
+        }
+        state.frames.pop_front();
+    }
+
+    /* 3. Soglia di Otsu esatta; la precedente decide solo i pareggi */
+    MomentTables t = BuildMomentTables(NormalizeCounts(state.counts));
+    int thresh = BestThreshold(t, state.lastThresh);
+
+    /* 4. Smussamento temporale */
+    state.smoothed = (state.lastThresh < 0) ? thresh : state.alpha * thresh + (1.0 - state.alpha) * state.smoothed;
+    state.lastThresh = thresh;
+    return cvRound(state.smoothed);
+}
+
+int StreamVideo(const String &name, StreamingOtsu &state) {
+    VideoCapture cap(name);
+    if (!cap.isOpened()) {
+        cout << "Could not open the video with name " << name << endl;
+        return -1;
+    }
+
+    Mat frame, gray, out;
+    int nFrames = 0;
+    int64 start = getTickCount();
+    while (cap.read(frame)) {
+        if (frame.channels() == 3) {
+            cvtColor(frame, gray, COLOR_BGR2GRAY);
+        }
+        else {
+            gray = frame;
+        }
+        int thresh = StreamingOtsuUpdate(state, gray);
+        threshold(gray, out, thresh, 255, THRESH_BINARY);
+        nFrames++;
+
+        imshow("Otsu video", out);
+        if (waitKey(1) == 27) {
+            break;
+        }
+    }
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    cout << nFrames << " frames, " << nFrames / seconds << " fps" << endl;
+    return 0;
 }
 
 int main(int argc, char **argv) {
+    // Modalità video: soglia di Otsu in streaming frame per frame
+    if (argc >= 3 && argc <= 6 && String(argv[1]) == "-v") {
+        StreamingOtsu state;
+        if (argc >= 4) state.windowFrames = stoi(argv[3]);
+        if (argc >= 5) state.rowStep = stoi(argv[4]);
+        if (argc == 6) state.alpha = stod(argv[5]);
+        if (state.windowFrames < 1 || state.rowStep < 1 || state.alpha <= 0.0 || state.alpha > 1.0) {
+            cout << "windowFrames and rowStep must be positive, alpha in (0, 1]" << endl;
+            return -1;
+        }
+        return StreamVideo(argv[2], state);
+    }
+
     // Controllo argomenti riga di comando
-    if (argc != 2) {
-        cout << "Usage: " << argv[0] << " image_name" << endl;
+    if (argc < 2 || argc > 5) {
+        cout << "Usage: " << argv[0] << " image_name [number_of_classes [tileSize [radius]]]" << endl;
+        cout << "       " << argv[0] << " -v video_name [windowFrames [rowStep [alpha]]]" << endl;
         return -1;
     }
 
@@ -152,11 +474,33 @@ int main(int argc, char **argv) {
     waitKey(0);
 
     /** Otsu con soglie multiple **/
-    vector<int> thresh = OtsuMultipleThresh(hist);
-    cout << "min: " << thresh[0] << " max: " << thresh[1] << endl;
+    int nClasses = (argc >= 3) ? stoi(argv[2]) : 3;
+    if (nClasses < 2 || nClasses > 256) {
+        cout << "number_of_classes must be between 2 and 256" << endl;
+        return -1;
+    }
+    vector<int> thresh = OtsuMultipleThresh(hist, nClasses);
+    cout << "thresholds:";
+    for (int t : thresh) {
+        cout << " " << t;
+    }
+    cout << endl;
     MultipleThreshold(src, out, thresh);
     imshow("Otsu2", out);
     waitKey(0);
 
+    /** Otsu adattivo a tile, per immagini con illuminazione non uniforme **/
+    if (argc >= 4) {
+        int tileSize = stoi(argv[3]);
+        int radius = (argc == 5) ? stoi(argv[4]) : 1;
+        if (tileSize < 1 || radius < 0) {
+            cout << "tileSize must be positive and radius non negative" << endl;
+            return -1;
+        }
+        AdaptiveOtsu(src, out, tileSize, radius);
+        imshow("Otsu adattivo", out);
+        waitKey(0);
+    }
+
     return 0;
 }
\ No newline at end of file